@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "delaunay.hh"
+#include "flip.hh"
+#include "quad_edge.hh"
+#include "radix_sort.hh"
+#include "task_pool.hh"
+
+// Triangulating lots of small point sets, of tens to hundreds of points each,
+// where what counts is how many sets get done per second rather than how long
+// any one of them takes. The sets are shared out among the workers of a pool
+// and every set is triangulated serially by one worker. Every worker keeps its
+// own mesh and buffers from one set to the next, so once they have grown to
+// the largest set nothing is allocated any more. The radix sort is meant for
+// big sets and costs more than it saves on small ones, so the points are
+// sorted by std::sort on a buffer of keys instead.
+//
+// The triangles of the whole batch end up in one array, set after set, every
+// triangle as three indices into its set in counter-clockwise order. Points
+// that repeat the coordinates of an earlier point of their set are left out,
+// and sets of points in a line have no triangles.
+
+template <typename P> class batch_triangulator {
+  public:
+    explicit batch_triangulator(task_pool &tasks) : tasks(tasks), workers(tasks.size()) {}
+
+    // Triangulate every set, set i being points[starts[i], starts[i + 1]),
+    // replacing the triangles of the last batch.
+    void triangulate(const std::vector<P> &points, const std::vector<std::size_t> &starts);
+
+    std::size_t sets() const { return triangle_start.size() - 1; }
+
+    // The triangles of set i, three indices each.
+    const std::uint32_t *triangles_begin(std::size_t i) const { return corners.data() + 3 * triangle_start[i]; }
+    const std::uint32_t *triangles_end(std::size_t i) const { return corners.data() + 3 * triangle_start[i + 1]; }
+    std::size_t triangle_count(std::size_t i) const { return triangle_start[i + 1] - triangle_start[i]; }
+
+    // The triangles of every set, one after the other.
+    const std::vector<std::uint32_t> &triangles() const { return corners; }
+
+  private:
+    struct worker {
+        mesh<const P *> graph;
+        std::vector<std::pair<std::uint64_t, std::uint32_t>> keys; // sort key and index in the set
+        std::vector<P> sorted;
+        std::vector<std::uint32_t> original; // the index in the set of every sorted point
+        std::vector<std::uint32_t> corners;  // the triangles of every set the worker did this batch
+    };
+
+    void triangulate_set(worker &w, const P *begin, const P *end);
+
+    task_pool &tasks;
+    std::vector<worker> workers;
+    std::vector<unsigned> set_worker;              // the worker that did every set
+    std::vector<std::size_t> set_corners;          // and where its triangles start in the worker's corners
+    std::vector<std::size_t> triangle_start = {0}; // the triangles of set i are [triangle_start[i], triangle_start[i + 1])
+    std::vector<std::uint32_t> corners;
+};
+
+template <typename P> void batch_triangulator<P>::triangulate(const std::vector<P> &points, const std::vector<std::size_t> &starts) {
+    const std::size_t count = starts.empty() ? 0 : starts.size() - 1;
+    for (worker &w : workers)
+        w.corners.clear();
+    set_worker.resize(count);
+    set_corners.resize(count);
+    triangle_start.assign(count + 1, 0);
+
+    // a set never forks, so no worker starts another set before it is done
+    // with the one it is on
+    tasks.parallel_for(0, count, 16, [&](std::size_t i) {
+        unsigned index = tasks.worker_index();
+        worker &w = workers[index];
+        set_worker[i] = index;
+        set_corners[i] = w.corners.size();
+        triangulate_set(w, points.data() + starts[i], points.data() + starts[i + 1]);
+        triangle_start[i + 1] = (w.corners.size() - set_corners[i]) / 3;
+    });
+
+    // gather the triangles of the workers into one array, in the order of the
+    // sets
+    for (std::size_t i = 0; i < count; i++)
+        triangle_start[i + 1] += triangle_start[i];
+    corners.resize(3 * triangle_start[count]);
+    tasks.parallel_for(0, count, 256, [&](std::size_t i) {
+        if (std::size_t n = triangle_count(i))
+            std::memcpy(&corners[3 * triangle_start[i]], &workers[set_worker[i]].corners[set_corners[i]], 3 * n * sizeof(std::uint32_t));
+    });
+}
+
+template <typename P> void batch_triangulator<P>::triangulate_set(worker &w, const P *begin, const P *end) {
+    using edge = edge_reference<const P *>;
+
+    // sort by x, then y, then index, so the first of equal points is the one
+    // that came first in the set
+    w.keys.clear();
+    for (const P *p = begin; p != end; p++)
+        w.keys.push_back({std::uint64_t(radix_coordinate(p->x)) << 32 | radix_coordinate(p->y), std::uint32_t(p - begin)});
+    std::sort(w.keys.begin(), w.keys.end());
+    w.sorted.clear();
+    w.original.clear();
+    for (std::size_t k = 0; k < w.keys.size(); k++) {
+        if (k > 0 && w.keys[k].first == w.keys[k - 1].first)
+            continue;
+        w.sorted.push_back(begin[w.keys[k].second]);
+        w.original.push_back(w.keys[k].second);
+    }
+    if (w.sorted.size() < 2)
+        return;
+
+    w.graph.clear();
+    delaunay(w.graph, w.sorted.begin(), w.sorted.end());
+
+    const P *sorted = w.sorted.data();
+    for_each_triangle(w.graph, [&](edge d) {
+        w.corners.push_back(w.original[d.ORG - sorted]);
+        w.corners.push_back(w.original[d.DEST - sorted]);
+        w.corners.push_back(w.original[d.l_prev().ORG - sorted]);
+    });
+}
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+// after windows.h
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "delaunay.hh"
+#include "instrument.hh"
+#include "quad_edge.hh"
+#include "radix_sort.hh"
+#include "task_pool.hh"
+
+// Times the triangulation of point sets of a few shapes that are hard in
+// different ways, at sizes going up by a factor of 10, without opening a
+// window. For every set it prints
+//   points       how many are left once duplicates are removed,
+//   sort ms      the best time of sort_unique() over the runs,
+//   build ms     the best time of parallel_delaunay() over the runs, with
+//                the default vertical cuts,
+//   alt ms       the same with Dwyer's alternating cuts,
+//   Mpts/s       millions of points triangulated per second by the build
+//                with vertical cuts,
+//   1 thread     the same for the serial delaunay(),
+//   made, kept   how many edges the build made and how many are left in the
+//                triangulation,
+//   mesh MB      the storage of the mesh,
+//   peak MB      the most memory the process has used so far. Sizes go up, so
+//                this is usually the peak of the largest set of the size.
+// Every set is generated from a fixed seed, so runs can be compared with each
+// other.
+//
+// usage: benchmark [largest size [distribution ...]]
+
+struct bench_point {
+    int x, y;
+    bool operator==(const bench_point &rhs) const { return x == rhs.x && y == rhs.y; }
+    bool operator<(const bench_point &rhs) const { return x != rhs.x ? x < rhs.x : y < rhs.y; }
+    friend std::ostream &operator<<(std::ostream &lhs, const bench_point &rhs) { return lhs << '(' << rhs.x << ", " << rhs.y << ')'; }
+};
+
+const int BENCH_RANGE = 1 << 30; // coordinates are in [0, BENCH_RANGE)
+
+// Points spread evenly over the square.
+std::vector<bench_point> uniform_points(std::size_t n, std::mt19937_64 &random) {
+    std::uniform_int_distribution<int> range(0, BENCH_RANGE - 1);
+    std::vector<bench_point> points(n);
+    for (bench_point &p : points)
+        p = {range(random), range(random)};
+    return points;
+}
+
+// Points in normally distributed clusters around 64 random centres, with lots
+// of empty space in between.
+std::vector<bench_point> clustered_points(std::size_t n, std::mt19937_64 &random) {
+    std::uniform_int_distribution<int> range(0, BENCH_RANGE - 1);
+    std::vector<bench_point> centres(64);
+    for (bench_point &c : centres)
+        c = {range(random), range(random)};
+    std::uniform_int_distribution<std::size_t> pick(0, centres.size() - 1);
+    std::normal_distribution<double> spread(0, BENCH_RANGE / 256.0);
+    auto clamp = [](double c) { return int(std::clamp(c, 0.0, BENCH_RANGE - 1.0)); };
+    std::vector<bench_point> points(n);
+    for (bench_point &p : points) {
+        const bench_point &c = centres[pick(random)];
+        p = {clamp(c.x + spread(random)), clamp(c.y + spread(random))};
+    }
+    return points;
+}
+
+// The first n points of a square integer grid, shuffled. Every cell is a
+// cocircular square, so nearly every in-circle test comes out as a tie and
+// has to be decided by the exact predicates.
+std::vector<bench_point> grid_points(std::size_t n, std::mt19937_64 &random) {
+    const std::size_t side = std::size_t(std::ceil(std::sqrt(double(n))));
+    std::vector<bench_point> points(n);
+    for (std::size_t i = 0; i < n; i++)
+        points[i] = {int(i % side), int(i / side)};
+    std::shuffle(points.begin(), points.end(), random);
+    return points;
+}
+
+// Points at most 2 away from a line across the square, which makes long thin
+// triangles and orientation tests that are hard to decide.
+std::vector<bench_point> collinear_points(std::size_t n, std::mt19937_64 &random) {
+    std::uniform_int_distribution<int> range(0, BENCH_RANGE - 1), jitter(-2, 2);
+    std::vector<bench_point> points(n);
+    for (bench_point &p : points) {
+        int x = range(random);
+        p = {x, int(std::int64_t(x) * 3 / 7) + BENCH_RANGE / 4 + jitter(random)};
+    }
+    return points;
+}
+
+// Points with the surface density of a Kuzmin disk, which falls off with the
+// cube of the distance from the centre: a dense core of tiny triangles and a
+// sparse halo of long thin ones stretching out to the edges.
+std::vector<bench_point> kuzmin_points(std::size_t n, std::mt19937_64 &random) {
+    std::uniform_real_distribution<double> unit(0, 1), angle(0, 2 * std::acos(-1.0));
+    const double scale = BENCH_RANGE / 1024.0, half = BENCH_RANGE / 2.0;
+    std::vector<bench_point> points(n);
+    for (bench_point &p : points) {
+        double x, y;
+        do { // the fraction of the disk within r is 1 - 1 / sqrt(1 + r^2)
+            double u = 1 - unit(random), r = scale * std::sqrt(1 / (u * u) - 1), a = angle(random);
+            x = half + r * std::cos(a);
+            y = half + r * std::sin(a);
+        } while (x < 0 || x >= BENCH_RANGE || y < 0 || y >= BENCH_RANGE);
+        p = {int(x), int(y)};
+    }
+    return points;
+}
+
+struct distribution {
+    const char *name;
+    std::vector<bench_point> (*generate)(std::size_t, std::mt19937_64 &);
+};
+
+const distribution distributions[] = {
+    {"uniform", uniform_points}, {"clustered", clustered_points}, {"grid", grid_points}, {"collinear", collinear_points}, {"kuzmin", kuzmin_points},
+};
+
+// Hands out the quad_edges of a mesh like the mesh itself, counting how many
+// are made and deleted on the way.
+template <typename T> class counting_pool {
+  public:
+    using value_type = T;
+
+    explicit counting_pool(mesh<T> &graph) : graph(graph) {}
+
+    edge_reference<T> allocate() {
+        made++;
+        return graph.allocate();
+    }
+    void release(edge_reference<T> e) {
+        deleted++;
+        graph.release(e);
+    }
+
+    std::uint64_t made = 0, deleted = 0;
+
+  private:
+    mesh<T> &graph;
+};
+
+std::size_t peak_memory() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss; // bytes
+#else
+    return std::size_t(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+#endif
+}
+
+template <typename F> double time_ms(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    std::size_t largest = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    std::vector<const distribution *> chosen;
+    for (int i = 2; i < argc; i++) {
+        auto d = std::find_if(std::begin(distributions), std::end(distributions), [&](const distribution &d) { return argv[i] == std::string(d.name); });
+        if (d == std::end(distributions)) {
+            std::cout << "unknown distribution " << argv[i] << ", pick from";
+            for (const distribution &d : distributions)
+                std::cout << " " << d.name;
+            std::cout << "\n";
+            return EXIT_FAILURE;
+        }
+        chosen.push_back(d);
+    }
+    if (chosen.empty())
+        for (const distribution &d : distributions)
+            chosen.push_back(&d);
+
+    task_pool tasks;
+    std::printf("%u threads\n", tasks.size());
+    std::printf("%-10s %10s %9s %9s %9s %8s %9s %11s %11s %6s %8s %8s\n", "", "points", "sort ms", "build ms", "alt ms", "Mpts/s", "1 thread", "made", "kept",
+                "kept%", "mesh MB", "peak MB");
+    for (std::size_t n = 1000; n <= largest; n *= 10) {
+        const std::size_t runs = std::clamp<std::size_t>(3000000 / n, 1, 100); // best of, so small sets don't just time the clock
+        for (const distribution *d : chosen) {
+            std::mt19937_64 random(n);
+            const std::vector<bench_point> generated = d->generate(n, random);
+
+            double sort_ms = INFINITY, build_ms = INFINITY, alternating_ms = INFINITY, serial_ms = INFINITY;
+            std::vector<bench_point> points;
+            std::size_t kept = 0, mesh_bytes = 0;
+            for (std::size_t run = 0; run < runs; run++) {
+                points = generated;
+                sort_ms = std::min(sort_ms, time_ms([&] { sort_unique(tasks, points); }));
+                mesh<const bench_point *> graph;
+                build_ms = std::min(build_ms, time_ms([&] { parallel_delaunay(graph, tasks, points.begin(), points.end()); }));
+                kept = graph.size();
+                mesh_bytes = std::size_t(graph.extent()) * sizeof(quad_edge<const bench_point *>);
+                // the alternating cuts partition the points in place, so they get a copy
+                std::vector<bench_point> partitioned = points;
+                mesh<const bench_point *> alternating;
+                alternating_ms = std::min(alternating_ms,
+                                          time_ms([&] { parallel_delaunay(alternating, tasks, partitioned.begin(), partitioned.end(), cut_mode::alternating); }));
+            }
+            std::uint64_t made = 0;
+            for (std::size_t run = 0; run < runs; run++) {
+                mesh<const bench_point *> graph;
+                counting_pool<const bench_point *> pool(graph);
+                serial_ms = std::min(serial_ms, time_ms([&] { delaunay(pool, points.begin(), points.end()); }));
+                made = pool.made;
+            }
+
+            std::printf("%-10s %10zu %9.2f %9.2f %9.2f %8.2f %9.2f %11llu %11zu %5.1f%% %8.1f %8.1f\n", d->name, points.size(), sort_ms, build_ms,
+                        alternating_ms, points.size() / build_ms / 1000, points.size() / serial_ms / 1000, (unsigned long long)made, kept, 100.0 * kept / made,
+                        mesh_bytes / 1048576.0, peak_memory() / 1048576.0);
+            std::fflush(stdout);
+        }
+    }
+#ifdef INSTRUMENT
+    instrument_report(std::cout);
+#endif
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+#include "instrument.hh"
+#include "predicates.hh"
+#include "quad_edge.hh"
+#include "task_pool.hh"
+
+// Guibas & Stolfi's divide-and-conquer Delaunay triangulation, for any point
+// type with x and y members. The mesh refers to the points by address, so they
+// must stay where they are for as long as the mesh is in use.
+//
+// Every change the algorithm makes to the mesh is reported to an observer,
+// which is passed along by reference and picked at compile time, so a build
+// with the null_observer has no hooks left in it at all. See below.
+
+// What changed in the mesh: a merge started, an edge was made, an edge was
+// connected, the base edge of a merge was connected, or an edge was deleted.
+enum class step_kind : std::uint8_t { merge, make_edge, connect, base, delete_edge };
+
+// An observer has a member
+//   void on_step(step_kind kind, edge_reference<const P *> e, const P &first, const P &last)
+// that is called with every change to the mesh, just before an edge is deleted
+// and just after one is made, and as a merge starts, with the edge ldi the
+// merge starts from. first and last are the first and last point of the
+// subproblem the step is part of. The parallel builds have subproblems
+// running on several threads at once, so they always use the null_observer.
+
+// Doesn't do anything, and compiles to nothing.
+struct null_observer {
+    template <typename P> void on_step(step_kind, edge_reference<const P *>, const P &, const P &) {}
+};
+
+// Prints every step.
+class trace_observer {
+  public:
+    explicit trace_observer(std::ostream &out) : out(out) {}
+
+    template <typename P> void on_step(step_kind kind, edge_reference<const P *> e, const P &first, const P &last) {
+        static const char *const names[] = {"merge", "make_edge", "connect", "connect base", "delete_edge"};
+        out << names[int(kind)];
+        if (kind == step_kind::merge)
+            out << " ( " << first << ", " << last << " )\n";
+        else
+            out << " " << e << " ( " << *e.ORG << " -> " << *e.DEST << " )\n";
+    }
+
+  private:
+    std::ostream &out;
+};
+
+// Tells two observers about every step, a first, then b.
+template <typename A, typename B> class observer_pair {
+  public:
+    observer_pair(A &a, B &b) : a(a), b(b) {}
+
+    template <typename P> void on_step(step_kind kind, edge_reference<const P *> e, const P &first, const P &last) {
+        a.on_step(kind, e, first, last);
+        b.on_step(kind, e, first, last);
+    }
+
+  private:
+    A &a;
+    B &b;
+};
+
+constexpr std::size_t PARALLEL_CUTOFF = 1 << 12; // subproblems at most this big are triangulated serially
+
+template <typename P> using edge_pair = std::pair<edge_reference<const P *>, edge_reference<const P *>>;
+template <typename It> using point_of = std::remove_const_t<typename std::iterator_traits<It>::value_type>;
+
+template <typename P> bool valid(edge_reference<const P *> e, edge_reference<const P *> base) { return right_of(*e.DEST, base); }
+
+// Stitch the triangulations L and R of [begin, mid) and [mid, end) together,
+// where ldo/ldi and rdi/rdo are the hull edges delaunay() returned for them.
+template <typename Pool, typename Observer, typename It, typename P = point_of<It>>
+edge_pair<P> merge(Pool &graph, Observer &observer, It begin, It end, edge_reference<const P *> ldo, edge_reference<const P *> ldi,
+                   edge_reference<const P *> rdi, edge_reference<const P *> rdo) {
+    using edge_t = edge_reference<const P *>;
+    INSTRUMENT_LEVEL(end - begin);
+    INSTRUMENT_COUNT(merges);
+    INSTRUMENT_TIME(merge_ns);
+    const P &first = begin[0], &last = end[-1];
+    observer.on_step(step_kind::merge, ldi, first, last);
+
+    while (true) { // find lower common tangent of L and R
+        if (left_of(*rdi.ORG, ldi))
+            ldi = ldi.l_next();
+        else if (right_of(*ldi.ORG, rdi))
+            rdi = rdi.r_prev();
+        else
+            break;
+    }
+    edge_t base_l = connect(graph, rdi.sym(), ldi); // create base RL edge
+    observer.on_step(step_kind::base, base_l, first, last);
+
+    if (ldi.ORG == ldo.ORG)
+        ldo = base_l.sym();
+    if (rdi.ORG == rdo.ORG)
+        rdo = base_l;
+
+    while (true) { // merge loop
+        INSTRUMENT_COUNT(merge_iterations);
+        edge_t l_cand = base_l.sym().o_next();
+        if (valid(l_cand, base_l)) {
+            while (in_circle(*base_l.DEST, *base_l.ORG, *l_cand.DEST, *l_cand.o_next().DEST)) {
+                edge_t t = l_cand.o_next();
+                observer.on_step(step_kind::delete_edge, l_cand, first, last);
+                delete_edge(graph, l_cand);
+                l_cand = t;
+            }
+        }
+        edge_t r_cand = base_l.o_prev();
+        if (valid(r_cand, base_l)) {
+            while (in_circle(*base_l.DEST, *base_l.ORG, *r_cand.DEST, *r_cand.o_prev().DEST)) {
+                edge_t t = r_cand.o_prev();
+                observer.on_step(step_kind::delete_edge, r_cand, first, last);
+                delete_edge(graph, r_cand);
+                r_cand = t;
+            }
+        }
+        if (!valid(l_cand, base_l) && !valid(r_cand, base_l))
+            break;
+        if (!valid(l_cand, base_l) || (valid(r_cand, base_l) && in_circle(*l_cand.DEST, *l_cand.ORG, *r_cand.ORG, *r_cand.DEST))) {
+            base_l = connect(graph, r_cand, base_l.sym());
+            observer.on_step(step_kind::connect, base_l, first, last);
+        } else {
+            base_l = connect(graph, base_l.sym(), l_cand.sym());
+            observer.on_step(step_kind::connect, base_l, first, last);
+        }
+    }
+    return {ldo, rdo};
+}
+
+// Triangulate [begin, end), which must be sorted by x, then y, and hold at
+// least two points, none of them twice. Returns the counter-clockwise hull edge
+// out of the first point and the clockwise hull edge out of the last one.
+template <typename Pool, typename Observer, typename It, typename P = point_of<It>> edge_pair<P> delaunay(Pool &graph, Observer &observer, It begin, It end) {
+    using edge_t = edge_reference<const P *>;
+    INSTRUMENT_LEVEL(end - begin);
+    const P &first = begin[0], &last = end[-1];
+    if (end - begin == 2) {
+        // create an edge from s1 to s2
+        edge_t a = make_edge(graph);
+        a.ORG = &begin[0];
+        a.DEST = &begin[1];
+        observer.on_step(step_kind::make_edge, a, first, last);
+        return {a, a.sym()};
+    } else if (end - begin == 3) {
+        // create triangle
+        const P &s1 = begin[0];
+        const P &s2 = begin[1];
+        const P &s3 = begin[2];
+
+        edge_t a = make_edge(graph);
+        edge_t b = make_edge(graph);
+        splice(a.sym(), b);
+        a.ORG = &s1;
+        a.DEST = &s2;
+        b.ORG = &s2;
+        b.DEST = &s3;
+        observer.on_step(step_kind::make_edge, a, first, last);
+        observer.on_step(step_kind::make_edge, b, first, last);
+
+        if (ccw(s1, s2, s3)) {
+            edge_t c = connect(graph, b, a);
+            observer.on_step(step_kind::connect, c, first, last);
+            return {a, b.sym()};
+        } else if (ccw(s1, s3, s2)) {
+            edge_t c = connect(graph, b, a);
+            observer.on_step(step_kind::connect, c, first, last);
+            return {c.sym(), c};
+        } else { // points are colinear
+            return {a, b.sym()};
+        }
+    } else {
+        auto mid = begin + (end - begin) / 2;
+        auto [ldo, ldi] = delaunay(graph, observer, begin, mid);
+        auto [rdi, rdo] = delaunay(graph, observer, mid, end);
+        return merge(graph, observer, begin, end, ldo, ldi, rdi, rdo);
+    }
+}
+
+template <typename Pool, typename It, typename P = point_of<It>> edge_pair<P> delaunay(Pool &graph, It begin, It end) {
+    null_observer none;
+    return delaunay(graph, none, begin, end);
+}
+
+// Parallel build: the two halves of every subproblem larger than cutoff are
+// triangulated as separate tasks, each in its own edge_slab, and merged once
+// both are done. Below the cutoff subproblems are handed to the serial
+// delaunay(). The result does not depend on the number of threads in tasks.
+template <typename It, typename P = point_of<It>>
+edge_pair<P> parallel_delaunay(task_pool &tasks, edge_slab<const P *> &slab, It begin, It end, std::size_t cutoff) {
+    if (std::size_t(end - begin) <= cutoff)
+        return delaunay(slab, begin, end);
+    auto mid = begin + (end - begin) / 2;
+    edge_slab<const P *> left = slab.split(3 * (mid - begin));
+    edge_pair<P> l, r;
+    tasks.fork_join([&] { l = parallel_delaunay(tasks, left, begin, mid, cutoff); }, [&] { r = parallel_delaunay(tasks, slab, mid, end, cutoff); });
+    slab.absorb(left);
+    null_observer none;
+    return merge(slab, none, begin, end, l.first, l.second, r.first, r.second);
+}
+
+template <typename It, typename P = point_of<It>>
+edge_pair<P> parallel_delaunay(mesh<const P *> &graph, task_pool &tasks, It begin, It end, std::size_t cutoff = PARALLEL_CUTOFF) {
+    const std::size_t n = 3 * (end - begin);
+    std::uint32_t block = graph.allocate_block(n);
+    edge_slab<const P *> slab(graph, block, block + n);
+    auto result = parallel_delaunay(tasks, slab, begin, end, std::max<std::size_t>(cutoff, 3));
+    graph.adopt(slab);
+    return result;
+}
+
+// How delaunay() divides its points. vertical splits at the median x every
+// time and needs the points sorted. alternating is Dwyer's variant, which cuts
+// by x and by y in turn so that subproblems stay roughly square instead of
+// turning into thin strips whose merges build and then delete long edges. It
+// partitions the points as it goes and takes them in any order.
+// Dwyer, A Faster Divide-and-Conquer Algorithm for Constructing Delaunay
+// Triangulations, Algorithmica 2, 1987
+enum class cut_mode { vertical, alternating };
+
+// A horizontal cut is a vertical cut in a frame turned a quarter clockwise,
+// where (x, y) becomes (y, -x). Orientation and in-circle tests don't change
+// under rotation, so merge() works unchanged as long as everything that
+// depends on the order of the points is done in the frame of the cut.
+template <typename P> bool frame_less(const P &a, const P &b, bool horizontal) {
+    if (horizontal)
+        return a.y != b.y ? a.y < b.y : a.x > b.x;
+    return a.x != b.x ? a.x < b.x : a.y < b.y;
+}
+
+// The hull edges merge() expects of a triangulation: counter-clockwise out of
+// its first vertex and clockwise out of its last one in the frame of the cut.
+// e can be any hull edge with the outside on its right.
+template <typename P> edge_pair<P> hull_extremes(edge_reference<const P *> e, bool horizontal) {
+    edge_reference<const P *> first = e, last = e; // ccw hull edges out of the first and into the last vertex
+    edge_reference<const P *> h = e;
+    do {
+        if (frame_less(*h.ORG, *first.ORG, horizontal))
+            first = h;
+        if (frame_less(*last.DEST, *h.DEST, horizontal))
+            last = h;
+        h = h.r_prev();
+    } while (h != e);
+    return {first, last.sym()};
+}
+
+template <typename Pool, typename Observer, typename It, typename P = point_of<It>>
+edge_pair<P> delaunay(Pool &graph, Observer &observer, It begin, It end, bool horizontal) {
+    auto less = [horizontal](const P &a, const P &b) { return frame_less(a, b, horizontal); };
+    if (end - begin <= 3) {
+        std::sort(begin, end, less);
+        return delaunay(graph, observer, begin, end);
+    }
+    auto mid = begin + (end - begin) / 2;
+    std::nth_element(begin, mid, end, less);
+    auto l = delaunay(graph, observer, begin, mid, !horizontal);
+    auto r = delaunay(graph, observer, mid, end, !horizontal);
+    auto [ldo, ldi] = hull_extremes(l.first, horizontal);
+    auto [rdi, rdo] = hull_extremes(r.first, horizontal);
+    return merge(graph, observer, begin, end, ldo, ldi, rdi, rdo);
+}
+
+template <typename Pool, typename It, typename P = point_of<It>> edge_pair<P> delaunay(Pool &graph, It begin, It end, bool horizontal) {
+    null_observer none;
+    return delaunay(graph, none, begin, end, horizontal);
+}
+
+template <typename It, typename P = point_of<It>>
+edge_pair<P> parallel_delaunay(task_pool &tasks, edge_slab<const P *> &slab, It begin, It end, std::size_t cutoff, bool horizontal) {
+    if (std::size_t(end - begin) <= cutoff)
+        return delaunay(slab, begin, end, horizontal);
+    auto mid = begin + (end - begin) / 2;
+    std::nth_element(begin, mid, end, [horizontal](const P &a, const P &b) { return frame_less(a, b, horizontal); });
+    edge_slab<const P *> left = slab.split(3 * (mid - begin));
+    edge_pair<P> l, r;
+    tasks.fork_join([&] { l = parallel_delaunay(tasks, left, begin, mid, cutoff, !horizontal); },
+                    [&] { r = parallel_delaunay(tasks, slab, mid, end, cutoff, !horizontal); });
+    slab.absorb(left);
+    auto [ldo, ldi] = hull_extremes(l.first, horizontal);
+    auto [rdi, rdo] = hull_extremes(r.first, horizontal);
+    null_observer none;
+    return merge(slab, none, begin, end, ldo, ldi, rdi, rdo);
+}
+
+// Either cut mode; with cut_mode::vertical this is the same as the build above.
+template <typename It, typename P = point_of<It>>
+edge_pair<P> parallel_delaunay(mesh<const P *> &graph, task_pool &tasks, It begin, It end, cut_mode mode, std::size_t cutoff = PARALLEL_CUTOFF) {
+    if (mode == cut_mode::vertical)
+        return parallel_delaunay(graph, tasks, begin, end, cutoff);
+    const std::size_t n = 3 * (end - begin);
+    std::uint32_t block = graph.allocate_block(n);
+    edge_slab<const P *> slab(graph, block, block + n);
+    auto result = parallel_delaunay(tasks, slab, begin, end, std::max<std::size_t>(cutoff, 3), false);
+    graph.adopt(slab);
+    return result;
+}
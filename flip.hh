@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include "predicates.hh"
+#include "quad_edge.hh"
+
+// true if the face to the left of e is a counter-clockwise triangle, which in
+// a valid triangulation means a bounded face and not the outside of the hull.
+template <typename P> bool left_triangle(edge_reference<const P *> e) {
+    edge_reference<const P *> f = e.l_next();
+    return f.l_next().l_next() == e && ccw(*e.ORG, *e.DEST, *f.DEST);
+}
+
+// Call f(d) once for every counter-clockwise triangle of the mesh, with d the
+// edge of it whose quad_edge is stored first, so the corners of the triangle
+// are d.Org, d.Dest and d.l_prev().Org in counter-clockwise order.
+template <typename P, typename F> void for_each_triangle(mesh<const P *> &graph, F f) {
+    graph.for_each_edge([&](edge_reference<const P *> q) {
+        for (edge_reference<const P *> d : {q, q.sym()})
+            if (left_triangle(d) && (d.l_next().h >> 2) > (q.h >> 2) && (d.l_prev().h >> 2) > (q.h >> 2))
+                f(d);
+    });
+}
+
+// An edge with triangles on both sides is locally Delaunay unless the far
+// corner of one triangle lies inside the circumcircle of the other. Hull
+// edges are always locally Delaunay.
+template <typename P> bool locally_delaunay(edge_reference<const P *> e) {
+    if (!left_triangle(e) || !left_triangle(e.sym()))
+        return true;
+    return !in_circle(*e.ORG, *e.DEST, *e.l_next().DEST, *e.o_prev().DEST);
+}
+
+// Lawson's algorithm: swap edges that aren't locally Delaunay until none are
+// left, starting from the edges on the stack. Only edges of the quadrilateral
+// around a swapped edge can become illegal, so those are all that get pushed.
+// Any triangulation whose suspicious edges are all on the stack comes out as
+// the Delaunay triangulation of its points.
+template <typename P> void restore_delaunay(std::vector<edge_reference<const P *>> &stack) {
+    while (!stack.empty()) {
+        edge_reference<const P *> e = stack.back();
+        stack.pop_back();
+        if (locally_delaunay(e))
+            continue;
+        swap(e);
+        stack.push_back(e.l_next());
+        stack.push_back(e.l_prev());
+        stack.push_back(e.r_next());
+        stack.push_back(e.r_prev());
+    }
+}
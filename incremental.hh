@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "flip.hh"
+#include "locate.hh"
+#include "predicates.hh"
+#include "quad_edge.hh"
+
+// Adding and removing single points in a Delaunay triangulation that is kept
+// in a mesh. Both only touch the triangles around the point, so once it has
+// been found an update changes a constant number of edges on average. Finding
+// it is a walk with locate() from the edge near, which costs O(sqrt n) steps
+// on average for points spread evenly over the mesh when it starts from the
+// hull, as it does by default, and an expected constant number of steps when
+// it starts from an edge close by, such as one from a point_locator.
+// outer must have the outside of the hull on its left (delaunay() returns one
+// as its second edge) and is moved along if the hull changes.
+
+// Connect x to the chain of hull edges it can see from outside the hull,
+// starting the search at e, which has the outside on its left and x left of or
+// on it. Returns false if x sees no hull edge at all.
+template <typename P> bool insert_outside(mesh<const P *> &graph, edge_reference<const P *> &outer, edge_reference<const P *> e, const P *x) {
+    using edge = edge_reference<const P *>;
+    auto visible = [x](edge c) { return orient2d(*c.ORG, *c.DEST, *x) > 0; };
+
+    // x may be in line with e, but then it sees one of the edges further along
+    edge first = e;
+    while (!visible(first))
+        if ((first = first.l_next()) == e)
+            return false;
+    for (edge start = first; visible(first.l_prev()) && first.l_prev() != start;)
+        first = first.l_prev();
+
+    edge s = make_edge(graph);
+    s.ORG = first.ORG;
+    s.DEST = x;
+    splice(first, s);
+
+    std::vector<edge> suspects;
+    edge b = s.sym();
+    for (edge c = first; visible(c) && c.l_next() != b;) {
+        edge next = c.l_next();
+        b = connect(graph, c, b).sym(); // closes the triangle c.Org c.Dest x
+        suspects.push_back(c);
+        c = next;
+    }
+    outer = s;
+    restore_delaunay(suspects);
+    return true;
+}
+
+// Add x to the triangulation, walking to it from near, or from outer if near
+// has no mesh. x must stay where it is for as long as the mesh refers to it.
+// Returns false, without changing the mesh, if there already is a point at x
+// or if the triangulation has no triangles to insert into.
+template <typename P>
+bool insert_site(mesh<const P *> &graph, edge_reference<const P *> &outer, const P *x, edge_reference<const P *> near = {nullptr, 0}) {
+    using edge = edge_reference<const P *>;
+
+    edge e = locate(near.m ? near : outer, *x);
+    if ((x->x == e.ORG->x && x->y == e.ORG->y) || (x->x == e.DEST->x && x->y == e.DEST->y))
+        return false;
+    if (!left_triangle(e)) {
+        if (!left_triangle(e.sym()))
+            return false;
+        return insert_outside(graph, outer, e, x);
+    }
+
+    for (edge g : {e, e.l_next(), e.l_prev()}) {
+        if (orient2d(*g.ORG, *g.DEST, *x) != 0)
+            continue;
+        if (!left_triangle(g.sym())) {
+            // x is on the hull: drop the hull edge and add x from the outside
+            edge f = g.l_next();
+            delete_edge(graph, g);
+            return insert_outside(graph, outer, f, x);
+        }
+        // From Guibas & Stolfi: x is on an inner edge, so merge the triangles
+        // on either side of it and add x to the quadrilateral
+        e = g.o_prev();
+        edge t = e.o_next();
+        delete_edge(graph, t);
+        break;
+    }
+
+    // From Guibas & Stolfi: connect x to every corner of the face left of e
+    edge base = make_edge(graph);
+    base.ORG = e.ORG;
+    base.DEST = x;
+    splice(base, e);
+    edge start = base;
+    std::vector<edge> suspects;
+    do {
+        suspects.push_back(e);
+        base = connect(graph, e, base.sym());
+        e = base.o_prev();
+    } while (e.l_next() != start);
+    suspects.push_back(e);
+    restore_delaunay(suspects);
+    return true;
+}
+
+// Fill the hole left of the chain of edges with Delaunay triangles, cutting off
+// ears whose circumcircle holds no other corner of the hole until only a
+// triangle is left if the chain is closed, or until the chain turns convex if
+// it is open, in which case the hole was part of the outside.
+template <typename P> bool fill_hole(mesh<const P *> &graph, std::vector<edge_reference<const P *>> &chain, bool closed) {
+    using edge = edge_reference<const P *>;
+    std::vector<edge> suspects;
+    while (chain.size() > (closed ? 3 : 1)) {
+        std::size_t ears = closed ? chain.size() : chain.size() - 1, i = 0;
+        bool convex = true;
+        for (; i < ears; i++) {
+            edge a = chain[i], b = chain[(i + 1) % chain.size()];
+            if (!ccw(*a.ORG, *a.DEST, *b.DEST))
+                continue;
+            convex = false;
+            bool empty = true;
+            for (edge c : chain)
+                if (c.ORG != a.ORG && c.ORG != a.DEST && c.ORG != b.DEST && in_circle(*a.ORG, *a.DEST, *b.DEST, *c.ORG))
+                    empty = false;
+            if (!closed && chain.back().DEST != a.ORG && chain.back().DEST != b.DEST && in_circle(*a.ORG, *a.DEST, *b.DEST, *chain.back().DEST))
+                empty = false;
+            if (empty)
+                break;
+        }
+        if (convex && !closed)
+            break;
+        if (i == ears)
+            return false;
+        edge c = connect(graph, chain[(i + 1) % chain.size()], chain[i]);
+        suspects.push_back(c);
+        chain[i] = c.sym();
+        chain.erase(chain.begin() + (i + 1) % chain.size());
+    }
+    restore_delaunay(suspects);
+    return true;
+}
+
+// Remove the point v from the triangulation by deleting the edges around it
+// and retriangulating the hole they leave, walking to v from near, or from
+// outer if near has no mesh. Returns false if v isn't in the mesh or the mesh
+// is too degenerate to patch; in the latter case the mesh may have been
+// partially modified and should be rebuilt.
+template <typename P>
+bool remove_site(mesh<const P *> &graph, edge_reference<const P *> &outer, const P *v, edge_reference<const P *> near = {nullptr, 0}) {
+    using edge = edge_reference<const P *>;
+
+    edge e = locate(near.m ? near : outer, *v);
+    if (e.DEST == v)
+        e = e.sym();
+    if (e.ORG != v)
+        return false;
+
+    // the edges around v, counter-clockwise, starting right after the outside
+    // of the hull if v is on it
+    std::vector<edge> star;
+    edge d = e;
+    do {
+        star.push_back(d);
+        d = d.o_next();
+    } while (d != e);
+    std::size_t outside = 0, last = 0;
+    for (std::size_t i = 0; i < star.size(); i++)
+        if (!left_triangle(star[i]))
+            outside++, last = i;
+    if (outside > 1 || star.size() < 2)
+        return false;
+    if (outside)
+        std::rotate(star.begin(), star.begin() + last + 1, star.end());
+
+    std::vector<edge> chain;
+    for (std::size_t i = 0; i + outside < star.size(); i++)
+        chain.push_back(star[i].l_next());
+    for (edge &s : star)
+        delete_edge(graph, s);
+    if (!fill_hole(graph, chain, outside == 0))
+        return false;
+    if (outside)
+        outer = chain.front();
+    return true;
+}
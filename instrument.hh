@@ -0,0 +1,163 @@
+#pragma once
+
+// Counters for finding out where a triangulation spends its time, compiled in
+// only when INSTRUMENT is defined. Without it the hooks below compile to
+// nothing, so the code they sit in is exactly what it would be without them;
+// INSTRUMENT_LEVEL still evaluates its size so that nothing used only for the
+// level is reported as unused.
+//
+// Everything is counted per level, the number of bits in the size of the
+// subproblem being worked on, which for the halving recursion of delaunay() is
+// its depth counted from the bottom. Work done outside of a triangulation,
+// like locating points or flipping edges afterwards, goes to level 0. Every
+// thread counts into counters of its own, which instrument_report() adds up,
+// so it must not be called while a triangulation is running.
+//
+// INSTRUMENT_LEVEL(n) sets the level to that of a subproblem of n points for
+// the rest of the scope, INSTRUMENT_COUNT(what) counts one more of a member of
+// level_counters, and INSTRUMENT_TIME(what) adds the time until the end of the
+// scope to one.
+
+#ifdef INSTRUMENT
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct level_counters {
+    std::uint64_t merges = 0;
+    std::uint64_t merge_iterations = 0; // rounds of the merge loop
+    std::uint64_t merge_ns = 0;         // wall time spent merging
+    std::uint64_t in_circle = 0;
+    std::uint64_t ccw = 0;
+    std::uint64_t made = 0; // edges
+    std::uint64_t deleted = 0;
+};
+
+constexpr unsigned instrument_levels = 65;
+
+struct thread_counters {
+    level_counters levels[instrument_levels];
+    unsigned level = 0;
+};
+
+// Counters of every thread that ever counted anything, kept after the thread
+// is gone so its counts still show up in the report.
+inline std::mutex &instrument_lock() {
+    static std::mutex lock;
+    return lock;
+}
+inline std::vector<std::shared_ptr<thread_counters>> &instrument_threads() {
+    static std::vector<std::shared_ptr<thread_counters>> threads;
+    return threads;
+}
+
+inline thread_counters &instrument_local() {
+    thread_local std::shared_ptr<thread_counters> counters = [] {
+        auto c = std::make_shared<thread_counters>();
+        std::lock_guard<std::mutex> guard(instrument_lock());
+        instrument_threads().push_back(c);
+        return c;
+    }();
+    return *counters;
+}
+
+inline void instrument_count(std::uint64_t level_counters::*what) {
+    thread_counters &c = instrument_local();
+    ++(c.levels[c.level].*what);
+}
+
+class instrument_scope {
+  public:
+    explicit instrument_scope(std::size_t n) : counters(instrument_local()), saved(counters.level) {
+        unsigned bits = 0;
+        for (; n; n >>= 1)
+            bits++;
+        counters.level = bits;
+    }
+    ~instrument_scope() { counters.level = saved; }
+
+    instrument_scope(const instrument_scope &) = delete;
+    instrument_scope &operator=(const instrument_scope &) = delete;
+
+  private:
+    thread_counters &counters;
+    unsigned saved;
+};
+
+class instrument_timer {
+  public:
+    explicit instrument_timer(std::uint64_t level_counters::*what) : what(what), start(std::chrono::steady_clock::now()) {}
+    ~instrument_timer() {
+        thread_counters &c = instrument_local();
+        c.levels[c.level].*what += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    instrument_timer(const instrument_timer &) = delete;
+    instrument_timer &operator=(const instrument_timer &) = delete;
+
+  private:
+    std::uint64_t level_counters::*what;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Write the counts of all threads as a table with a line per level, then set
+// them back to zero.
+inline void instrument_report(std::ostream &out) {
+    level_counters sum[instrument_levels], total;
+    {
+        std::lock_guard<std::mutex> guard(instrument_lock());
+        for (const auto &t : instrument_threads()) {
+            for (unsigned l = 0; l < instrument_levels; l++) {
+                const level_counters &c = t->levels[l];
+                for (level_counters *s : {&sum[l], &total}) {
+                    s->merges += c.merges;
+                    s->merge_iterations += c.merge_iterations;
+                    s->merge_ns += c.merge_ns;
+                    s->in_circle += c.in_circle;
+                    s->ccw += c.ccw;
+                    s->made += c.made;
+                    s->deleted += c.deleted;
+                }
+            }
+            std::fill(std::begin(t->levels), std::end(t->levels), level_counters{});
+        }
+    }
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    auto row = [&out](const std::string &points, const level_counters &c) {
+        out << std::setw(24) << points << std::setw(10) << c.merges << std::setw(12) << c.merge_iterations << std::setw(12) << std::fixed << std::setprecision(3)
+            << c.merge_ns / 1e6 << std::setw(14) << c.in_circle << std::setw(14) << c.ccw << std::setw(12) << c.made << std::setw(12) << c.deleted << "\n";
+    };
+    out << std::setw(24) << "points" << std::setw(10) << "merges" << std::setw(12) << "iterations" << std::setw(12) << "merge ms" << std::setw(14) << "in_circle"
+        << std::setw(14) << "ccw" << std::setw(12) << "made" << std::setw(12) << "deleted" << "\n";
+    for (unsigned l = 0; l < instrument_levels; l++) {
+        const level_counters &c = sum[l];
+        if (!c.merges && !c.in_circle && !c.ccw && !c.made && !c.deleted)
+            continue;
+        row(l == 0 ? "outside" : std::to_string(std::uint64_t(1) << (l - 1)) + " to " + std::to_string((std::uint64_t(1) << (l - 1)) * 2 - 1), c);
+    }
+    row("total", total);
+    out.flags(flags);
+    out.precision(precision);
+}
+
+#define INSTRUMENT_LEVEL(n) instrument_scope instrument_level_scope(n)
+#define INSTRUMENT_COUNT(what) instrument_count(&level_counters::what)
+#define INSTRUMENT_TIME(what) instrument_timer instrument_##what##_timer(&level_counters::what)
+
+#else
+
+#define INSTRUMENT_LEVEL(n) ((void)(n))
+#define INSTRUMENT_COUNT(what)
+#define INSTRUMENT_TIME(what)
+
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "flip.hh"
+#include "predicates.hh"
+#include "quad_edge.hh"
+
+// Bring a Delaunay triangulation back up to date after its points have moved
+// in place, keeping the mesh instead of rebuilding it. As long as every
+// triangle still has the same orientation the mesh is still a triangulation of
+// the points, just not necessarily a Delaunay one, and a round of edge swaps
+// fixes it. Points that leave the hull are handled by filling the dents they
+// leave behind with new triangles.
+// outer must have the outside of the hull on its left (delaunay() returns one
+// as its second edge); it is moved along if the hull changes. Returns false
+// when the points moved too far for the mesh to be repaired locally, in which
+// case the mesh is no longer usable and the triangulation should be rebuilt.
+template <typename P> bool kinetic_update(mesh<const P *> &graph, edge_reference<const P *> &outer) {
+    using edge = edge_reference<const P *>;
+
+    std::vector<edge> hull; // walked clockwise, so that the outside is on the left
+    edge e = outer;
+    do {
+        hull.push_back(e);
+        e = e.l_next();
+    } while (e != outer);
+
+    std::vector<bool> on_hull(std::size_t(graph.extent()) * 4);
+    for (edge h : hull)
+        on_hull[h.h] = true;
+    for (edge h : hull)
+        if (on_hull[h.sym().h]) // the outside reaches both sides of an edge: the points are collinear
+            return hull.size() == 2;
+
+    // A hull vertex that moved inwards leaves a left turn in the clockwise walk.
+    // Fill it in with a triangle unless another part of the hull is in the way.
+    for (bool dented = true; dented && hull.size() > 3;) {
+        dented = false;
+        for (std::size_t i = 0; i < hull.size() && hull.size() > 3; i++) {
+            std::size_t j = (i + 1) % hull.size();
+            edge a = hull[i], b = hull[j];
+            if (orient2d(*a.ORG, *a.DEST, *b.DEST) <= 0)
+                continue;
+            for (edge h : hull)
+                if (h.ORG != a.ORG && h.ORG != a.DEST && h.ORG != b.DEST && orient2d(*a.ORG, *a.DEST, *h.ORG) >= 0 &&
+                    orient2d(*a.DEST, *b.DEST, *h.ORG) >= 0 && orient2d(*b.DEST, *a.ORG, *h.ORG) >= 0)
+                    return false;
+            edge c = connect(graph, b, a);
+            on_hull.resize(std::size_t(graph.extent()) * 4);
+            on_hull[a.h] = on_hull[b.h] = false;
+            on_hull[c.sym().h] = true;
+            hull[i] = c.sym();
+            hull.erase(hull.begin() + j);
+            if (j < i)
+                i--;
+            dented = true;
+        }
+    }
+    outer = hull[0];
+
+    // Anything that isn't the outside must still be a counter-clockwise triangle.
+    bool folded = false;
+    std::vector<edge> stack;
+    stack.reserve(graph.size());
+    graph.for_each_edge([&](edge q) {
+        for (edge d : {q, q.sym()})
+            if (!on_hull[d.h] && !left_triangle(d))
+                folded = true;
+        stack.push_back(q);
+    });
+    if (folded)
+        return false;
+
+    restore_delaunay(stack);
+    return true;
+}
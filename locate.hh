@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "flip.hh"
+#include "predicates.hh"
+#include "quad_edge.hh"
+#include "task_pool.hh"
+
+// From Guibas & Stolfi:
+// Walk from e towards x. Returns an edge e such that x is e.Org or e.Dest, or
+// lies inside or on the triangle to the left of e. If x is outside the hull the
+// walk stops at the hull edge where it left the mesh, which is returned with
+// the outside on its left and x strictly to the left of it.
+// Only crossing edges that x is strictly beyond keeps points on the hull from
+// being mistaken for points outside of it.
+template <typename P> edge_reference<const P *> locate(edge_reference<const P *> e, const P &x) {
+    if (!left_triangle(e))
+        e = e.sym();
+    if (!left_triangle(e)) // no triangles around this edge at all
+        return e;
+    while (true) {
+        if ((x.x == e.ORG->x && x.y == e.ORG->y) || (x.x == e.DEST->x && x.y == e.DEST->y))
+            return e;
+        if (right_of(x, e))
+            e = e.sym();
+        else if (left_of(x, e.o_next()))
+            e = e.o_next();
+        else if (left_of(x, e.d_prev()))
+            e = e.d_prev();
+        else if (x.x == e.l_prev().ORG->x && x.y == e.l_prev().ORG->y)
+            return e.l_prev();
+        else
+            return e;
+        if (!left_triangle(e))
+            return e;
+    }
+}
+
+// Jump-and-walk point location: a grid over the bounding box of the points
+// keeps, for every cell, an edge leaving the point closest to the middle of the
+// cell. A query jumps to the edge of its cell and walks from there. With about
+// two points per cell the walk takes an expected constant number of steps for
+// points that are spread evenly.
+// The index holds edge handles, so it has to be rebuilt whenever the mesh
+// changes, except for near(). Queries only read the mesh and can run in
+// parallel.
+template <typename P> class point_locator {
+  public:
+    using edge = edge_reference<const P *>;
+
+    explicit point_locator(mesh<const P *> &graph) : graph(&graph) {
+        bool first = true;
+        graph.for_each_edge([&](edge e) {
+            for (const P *v : {e.ORG, e.DEST}) {
+                min_x = first ? double(v->x) : std::min(min_x, double(v->x));
+                min_y = first ? double(v->y) : std::min(min_y, double(v->y));
+                max_x = first ? double(v->x) : std::max(max_x, double(v->x));
+                max_y = first ? double(v->y) : std::max(max_y, double(v->y));
+                first = false;
+            }
+        });
+        double width = std::max(max_x - min_x, 1.0), height = std::max(max_y - min_y, 1.0);
+        double cells = std::max(double(graph.size()) / 6, 1.0); // a triangulation has about three edges per point
+        cell_size = std::sqrt(width * height / cells);
+        columns = std::max(1u, unsigned(std::min(width / cell_size, cells)) + 1);
+        rows = std::max(1u, unsigned(std::min(height / cell_size, cells)) + 1);
+        start.assign(std::size_t(columns) * rows, mesh<const P *>::no_edge);
+
+        std::vector<double> best(start.size());
+        graph.for_each_edge([&](edge q) {
+            for (edge e : {q, q.sym()}) {
+                std::size_t c = cell(*e.ORG);
+                double dx = double(e.ORG->x) - (min_x + (c % columns + 0.5) * cell_size);
+                double dy = double(e.ORG->y) - (min_y + (c / columns + 0.5) * cell_size);
+                if (start[c] == mesh<const P *>::no_edge || dx * dx + dy * dy < best[c]) {
+                    start[c] = e.h;
+                    best[c] = dx * dx + dy * dy;
+                }
+            }
+        });
+
+        // empty cells borrow from their neighbours, first along the rows,
+        // then rows that are still empty from the rows next to them
+        for (unsigned y = 0; y < rows; y++) {
+            edge_handle *row = &start[std::size_t(y) * columns];
+            for (unsigned x = 1; x < columns; x++)
+                if (row[x] == mesh<const P *>::no_edge)
+                    row[x] = row[x - 1];
+            for (unsigned x = columns - 1; x-- > 0;)
+                if (row[x] == mesh<const P *>::no_edge)
+                    row[x] = row[x + 1];
+        }
+        for (unsigned y = 1; y < rows; y++)
+            if (start[std::size_t(y) * columns] == mesh<const P *>::no_edge)
+                std::copy_n(&start[std::size_t(y - 1) * columns], columns, &start[std::size_t(y) * columns]);
+        for (unsigned y = rows - 1; y-- > 0;)
+            if (start[std::size_t(y) * columns] == mesh<const P *>::no_edge)
+                std::copy_n(&start[std::size_t(y + 1) * columns], columns, &start[std::size_t(y) * columns]);
+    }
+
+    // Same result as locate() above.
+    edge operator()(const P &x) const { return ::locate(graph->ref(start[cell(x)]), x); }
+
+    // An edge close to x to start a walk from, which still works after the
+    // mesh has been changed by adding and removing points: the edge of the
+    // cell of x if its quad_edge is still in use, and otherwise fallback.
+    // The walks get longer as the mesh drifts away from the index, but stay
+    // correct.
+    edge near(const P &x, edge fallback) const {
+        edge_handle h = start[cell(x)];
+        bool live = (h >> 2) < graph->extent() && (*graph)[h >> 2].next[1] != mesh<const P *>::no_edge;
+        return live ? graph->ref(h) : fallback;
+    }
+
+    // Locate every point in [first, last), writing the edges to out.
+    template <typename It, typename Out> void operator()(It first, It last, Out out) const {
+        for (; first != last; ++first, ++out)
+            *out = (*this)(*first);
+    }
+
+    // Locate count points in parallel, writing the i-th result to out[i].
+    template <typename It, typename Out> void operator()(task_pool &tasks, It first, std::size_t count, Out out) const {
+        tasks.parallel_for(0, count, 1024, [&](std::size_t i) { out[i] = (*this)(first[i]); });
+    }
+
+  private:
+    std::size_t cell(const P &x) const {
+        double fx = (double(x.x) - min_x) / cell_size, fy = (double(x.y) - min_y) / cell_size;
+        unsigned cx = fx <= 0 ? 0 : fx >= columns ? columns - 1 : unsigned(fx);
+        unsigned cy = fy <= 0 ? 0 : fy >= rows ? rows - 1 : unsigned(fy);
+        return std::size_t(cy) * columns + cx;
+    }
+
+    mesh<const P *> *graph;
+    double min_x = 0, min_y = 0, max_x = 0, max_y = 0, cell_size = 1;
+    unsigned columns = 1, rows = 1;
+    std::vector<edge_handle> start;
+};
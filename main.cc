@@ -1,16 +1,37 @@
 #include <SDL2/SDL.h>
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstring>
-#include <deque>
 #include <iostream>
 #include <random>
 #include <string>
-#include <tuple>
-#include <unordered_set>
+#include <thread>
 #include <vector>
 
+// With RENDER_STEP_ENABLE every step of the triangulation is recorded to be
+// replayed in the window, and with PRINT_STEPS as well the steps are printed.
+// Build with INSTRUMENT to get counts of what the triangulations did, by
+// subproblem size, when the program ends.
+#define RENDER_STEP_ENABLE
+// #define PRINT_STEPS
+
+#include "delaunay.hh"
+#include "incremental.hh"
+#include "instrument.hh"
+#include "kinetic.hh"
+#include "locate.hh"
+#include "mesh_file.hh"
+#include "predicates.hh"
+#include "proximity.hh"
 #include "quad_edge.hh"
+#include "radix_sort.hh"
+#include "raster.hh"
+#include "relayout.hh"
+#include "step_log.hh"
+#include "streaming.hh"
+#include "task_pool.hh"
+#include "voronoi.hh"
 
 using namespace std::string_literals;
 
@@ -41,232 +62,86 @@ template <> struct hash<vertex> {
 } // namespace std
 
 using edge_t = edge_reference<const vertex *>;
-
-/* true if and only if point D is interior to the region of the plane that is
- * bounded by the oriented circle ABC and lies to the left of it.
- * equivalent to:
- * | a.x  a.y  a.x^2 + a.y^2  1 |
- * | b.x  b.y  b.x^2 + b.y^2  1 |
- * | c.x  c.y  c.x^2 + c.y^2  1 |
- * | d.x  d.y  d.x^2 + d.y^2  1 |
- * =
- *                 | b.x  b.y  1 |
- * + a.x^2 + a.y^2 | c.x  c.y  1 |
- *                 | d.x  d.y  1 |
- *
- *                 | a.x  a.y  1 |
- * - b.x^2 + b.y^2 | c.x  c.y  1 |
- *                 | d.x  d.y  1 |
- *
- *                 | a.x  a.y  1 |
- * + c.x^2 + c.y^2 | b.x  b.y  1 |
- *                 | d.x  d.y  1 |
- *
- *                 | a.x  a.y  1 |
- * - d.x^2 + d.y^2 | b.x  b.y  1 |
- *                 | c.x  c.y  1 |
- * > 0
- */
-bool in_circle(vertex a, vertex b, vertex c, vertex d) {
-    // TODO optimize math prevent overflow
-    return (((int64_t)a.x * a.x + a.y * a.y) * ((b.x * c.y - b.y * c.x) - (b.x * d.y - b.y * d.x) + (c.x * d.y - c.y * d.x)) -
-            ((int64_t)b.x * b.x + b.y * b.y) * ((a.x * c.y - a.y * c.x) - (a.x * d.y - a.y * d.x) + (c.x * d.y - c.y * d.x)) +
-            ((int64_t)c.x * c.x + c.y * c.y) * ((a.x * b.y - a.y * b.x) - (a.x * d.y - a.y * d.x) + (b.x * d.y - b.y * d.x)) -
-            ((int64_t)d.x * d.x + d.y * d.y) * ((a.x * b.y - a.y * b.x) - (a.x * c.y - a.y * c.x) + (b.x * c.y - b.y * c.x))) > 0;
-}
-
-// true if the triangle a b c is oriented counter-clockwise.
-// equivalent to:
-// | a.x  a.y  1 |
-// | b.x  b.y  1 | > 0
-// | c.x  c.y  1 |
-bool ccw(vertex a, vertex b, vertex c) { return ((a.x * b.y - a.y * b.x) - (a.x * c.y - a.y * c.x) + (b.x * c.y - b.y * c.x)) > 0; }
-bool right_of(vertex x, edge_t e) { return ccw(x, *e.DEST, *e.ORG); }
-bool left_of(vertex x, edge_t e) { return ccw(x, *e.ORG, *e.DEST); }
-bool valid(edge_t e, edge_t base) { return right_of(*e.DEST, base); }
+using mesh_t = mesh<const vertex *>;
 
 SDL_Window *window = nullptr;
 SDL_Renderer *window_renderer = nullptr;
 SDL_Texture *graph_texture = nullptr;
 
-void draw_graph(SDL_Renderer *renderer, edge_t l, edge_t r) {
-
-    std::deque<edge_t> edge_queue;
-    std::unordered_set<const vertex *> checked_verts;
-    edge_queue.push_back(l);
-    checked_verts.insert(l.ORG);
-    edge_queue.push_back(r);
-    checked_verts.insert(r.ORG);
-
-    while (!edge_queue.empty()) {
-        edge_t p = edge_queue.front();
-        edge_queue.pop_front();
-        edge_t e = p;
-        do {
-            if (checked_verts.insert(e.DEST).second)
-                edge_queue.push_back(e.sym());
-            SDL_RenderDrawLine(renderer, e.ORG->x, e.ORG->y, e.DEST->x, e.DEST->y);
-            e = e.o_next();
-        } while (e != p);
-    }
-}
-
-void do_render_step(edge_t l, edge_t r, const vertex &begin, const vertex &end) {
-    SDL_Surface *surface;
-    SDL_LockTextureToSurface(graph_texture, NULL, &surface);
-    SDL_Renderer *surface_renderer = SDL_CreateSoftwareRenderer(surface);
+SDL_Surface *graph_surface = nullptr; // drawn on by graph_renderer and copied to graph_texture
+SDL_Renderer *graph_renderer = nullptr;
 
-    const int bbox_oversize = 3;
-    SDL_Rect bbox = {begin.x - bbox_oversize, 0, end.x - begin.x + 1 + 2 * bbox_oversize, surface->h};
-    SDL_SetRenderDrawColor(surface_renderer, 0x00, 0x00, 0x00, SDL_ALPHA_OPAQUE);
-    SDL_RenderFillRect(surface_renderer, &bbox);
-
-    SDL_SetRenderDrawColor(surface_renderer, 0x00, 0xFF, 0xFF, SDL_ALPHA_OPAQUE);
-    SDL_RenderDrawRect(surface_renderer, &bbox);
-
-    SDL_SetRenderDrawColor(surface_renderer, 0xFF, 0xFF, 0xFF, SDL_ALPHA_OPAQUE);
-    draw_graph(surface_renderer, l, r);
-
-    SDL_DestroyRenderer(surface_renderer);
-    SDL_UnlockTexture(graph_texture);
+void update_graph_texture() {
+    SDL_RenderFlush(graph_renderer);
+    SDL_UpdateTexture(graph_texture, NULL, graph_surface->pixels, graph_surface->pitch);
+}
 
-    SDL_SetRenderDrawColor(window_renderer, 0x00, 0x00, 0x00, SDL_ALPHA_OPAQUE);
-    SDL_RenderClear(window_renderer);
-    SDL_RenderCopyEx(window_renderer, graph_texture, NULL, NULL, 0, 0, SDL_FLIP_VERTICAL);
-    SDL_RenderPresent(window_renderer);
+SDL_Point to_pixel(const raster_view &view, double x, double y) { return {int(std::floor(view.pixel_x(x))), int(std::floor(view.pixel_y(y)))}; }
+
+// The points in view, unless there are so many of them that they would hide
+// the mesh, at more than one for every 64 pixels.
+template <typename P> void draw_points(SDL_Renderer *renderer, const std::vector<P> &points, const raster_view &view) {
+    const std::size_t most = std::size_t(graph_surface->w) * graph_surface->h / 64;
+    std::vector<SDL_Point> dots;
+    for (const P &p : points) {
+        double x = view.pixel_x(p.x), y = view.pixel_y(p.y);
+        if (x < 0 || x >= graph_surface->w || y < 0 || y >= graph_surface->h)
+            continue;
+        if (dots.size() == most)
+            return;
+        dots.push_back({int(x), int(y)});
+    }
+    SDL_RenderDrawPoints(renderer, dots.data(), int(dots.size()));
+}
 
-    bool cont = false;
-    SDL_Event event;
-    std::cout << "waiting\n";
-    while (!cont) {
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT)
-                std::cout << "quit event in render step" << std::endl;
-            if (event.type == SDL_KEYDOWN)
-                if (event.key.keysym.sym == SDLK_SPACE)
-                    cont = true;
-        }
+// Draw the cells that reach into visible, skipping the others before they
+// are turned into pixels.
+void draw_cells(SDL_Renderer *renderer, const voronoi_diagram &cells, const raster_view &view, voronoi_box visible) {
+    std::vector<SDL_Point> outline;
+    for (std::size_t i = 0; i < cells.cells(); i++) {
+        voronoi_box bounds{INFINITY, INFINITY, -INFINITY, -INFINITY};
+        for (const voronoi_point *p = cells.cell_begin(i); p != cells.cell_end(i); p++)
+            bounds = {std::min(bounds.left, p->x), std::min(bounds.bottom, p->y), std::max(bounds.right, p->x), std::max(bounds.top, p->y)};
+        if (bounds.right < visible.left || bounds.left > visible.right || bounds.top < visible.bottom || bounds.bottom > visible.top)
+            continue;
+        outline.clear();
+        for (const voronoi_point *p = cells.cell_begin(i); p != cells.cell_end(i); p++)
+            outline.push_back(to_pixel(view, p->x, p->y));
+        if (outline.empty())
+            continue;
+        outline.push_back(outline.front());
+        SDL_RenderDrawLines(renderer, outline.data(), int(outline.size()));
     }
 }
 
-#define PRINT_EDGE(e) e << " ( " << *e.ORG << " -> " << *e.DEST << " )"
-#define DEBUG(p) p
-#define RENDER_STEP_ENABLE
-#ifdef RENDER_STEP_ENABLE
-#define RENDER_STEP(l, r) do_render_step(l, r, begin[0], end[-1])
-#else
-#define RENDER_STEP(l, r)
-#endif
+void draw_replay(const step_replay &replay, const std::vector<vertex> &points, const raster_view &view) {
+    SDL_SetRenderDrawColor(graph_renderer, 0x00, 0x00, 0x00, SDL_ALPHA_OPAQUE);
+    SDL_RenderClear(graph_renderer);
+
+    // outline the subproblem being merged
+    if (const step *m = replay.merging()) {
+        const int bbox_oversize = 3;
+        int left = to_pixel(view, points[m->a].x, 0).x, right = to_pixel(view, points[m->b].x, 0).x;
+        SDL_Rect bbox = {left - bbox_oversize, 0, right - left + 1 + 2 * bbox_oversize, graph_surface->h};
+        SDL_SetRenderDrawColor(graph_renderer, 0x00, 0xFF, 0xFF, SDL_ALPHA_OPAQUE);
+        SDL_RenderDrawRect(graph_renderer, &bbox);
+    }
 
-std::pair<edge_t, edge_t> delaunay(std::vector<vertex>::const_iterator begin, std::vector<vertex>::const_iterator end) {
-    DEBUG(std::cout << "->   delaunay( " << *begin << ", " << end[-1] << " )\n";)
-    if (end - begin == 2) {
-        // create an edge from s1 to s2
-        edge_t a = make_edge<const vertex *>();
-        a.ORG = &begin[0];
-        a.DEST = &begin[1];
-        DEBUG(std::cout << "make_edge " << PRINT_EDGE(a) << "\n"
-                        << "<-1  delaunay( " << *begin << ", " << end[-1] << " ) : [ " << a << ", " << a.sym() << " ]\n";)
-        RENDER_STEP(a, a.sym());
-        return {a, a.sym()};
-    } else if (end - begin == 3) {
-        // create triangle
-        const vertex &s1 = begin[0];
-        const vertex &s2 = begin[1];
-        const vertex &s3 = begin[2];
-
-        edge_t a = make_edge<const vertex *>();
-        edge_t b = make_edge<const vertex *>();
-        splice(a.sym(), b);
-        a.ORG = &s1;
-        a.DEST = &s2;
-        b.ORG = &s2;
-        b.DEST = &s3;
-
-        RENDER_STEP(a, b);
-
-        if (ccw(s1, s2, s3)) {
-            // edge_t c =
-            connect(b, a);
-            RENDER_STEP(a, b);
-            DEBUG(std::cout << "<-2a delaunay( " << *begin << ", " << end[-1] << " ) : [ " << a << ", " << b.sym() << " ]\n";)
-            return {a, b.sym()};
-        } else if (ccw(s1, s3, s2)) {
-            edge_t c = connect(b, a);
-            RENDER_STEP(a, b);
-            DEBUG(std::cout << "<-2b delaunay( " << *begin << ", " << end[-1] << " ) : [ " << c.sym() << ", " << c.sym() << " ]\n";)
-            return {c.sym(), c};
-        } else { // points are colinear
-            DEBUG(std::cout << "<-2c delaunay( " << *begin << ", " << end[-1] << " ) : [ " << a << ", " << b.sym() << " ]\n";)
-            return {a, b.sym()};
-        }
-    } else {
-        auto mid = begin + (end - begin) / 2;
-        auto [ldo, ldi] = delaunay(begin, mid);
-        auto [rdi, rdo] = delaunay(mid, end);
-        RENDER_STEP(ldo, rdo);
-
-        DEBUG(std::cout << "--   delaunay( " << *begin << ", " << end[-1] << " )\n"
-                        << "ldi " << PRINT_EDGE(ldi) << "\nrdi " << PRINT_EDGE(rdi) << "\n";)
-
-        while (true) { // find lower common tangent of L and R
-            if (left_of(*rdi.ORG, ldi))
-                ldi = ldi.l_next();
-            else if (right_of(*ldi.ORG, rdi))
-                rdi = rdi.r_prev();
-            else
-                break;
-        }
-        DEBUG(std::cout << "found base\n"
-                        << "ldi " << PRINT_EDGE(ldi) << "\nrdi " << PRINT_EDGE(rdi) << "\n";)
-        edge_t base_l = connect(rdi.sym(), ldi); // create base RL edge
-        DEBUG(std::cout << "connect base " << PRINT_EDGE(base_l) << "\n";)
-        RENDER_STEP(ldi, rdi);
-
-        if (ldi.ORG == ldo.ORG)
-            ldo = base_l.sym();
-        if (rdi.ORG == rdo.ORG)
-            rdo = base_l;
-
-        while (true) { // merge loop
-            edge_t l_cand = base_l.sym().o_next();
-            if (valid(l_cand, base_l)) {
-                while (in_circle(*base_l.DEST, *base_l.ORG, *l_cand.DEST, *l_cand.o_next().DEST)) {
-                    edge_t t = l_cand.o_next();
-                    DEBUG(std::cout << "delete L cand" << PRINT_EDGE(l_cand) << "\n";)
-                    delete_edge(l_cand);
-                    l_cand = t;
-                    RENDER_STEP(ldo, rdo);
-                }
-            }
-            edge_t r_cand = base_l.o_prev();
-            if (valid(r_cand, base_l)) {
-                while (in_circle(*base_l.DEST, *base_l.ORG, *r_cand.DEST, *r_cand.o_prev().DEST)) {
-                    edge_t t = r_cand.o_prev();
-                    DEBUG(std::cout << "delete R cand " << PRINT_EDGE(r_cand) << "\n";)
-                    delete_edge(r_cand);
-                    r_cand = t;
-                    RENDER_STEP(ldo, rdo);
-                }
-            }
-            if (!valid(l_cand, base_l) && !valid(r_cand, base_l)) {
-                DEBUG(std::cout << "L & R cand invalid, break\n";)
-                break;
-            }
-            if (!valid(l_cand, base_l) || (valid(r_cand, base_l) && in_circle(*l_cand.DEST, *l_cand.ORG, *r_cand.ORG, *r_cand.DEST))) {
-                base_l = connect(r_cand, base_l.sym());
-                DEBUG(std::cout << "connect R cand " << PRINT_EDGE(base_l) << "\n";)
-                RENDER_STEP(ldo, rdo);
-            } else {
-                base_l = connect(base_l.sym(), l_cand.sym());
-                DEBUG(std::cout << "connect L cand " << PRINT_EDGE(base_l) << "\n";)
-                RENDER_STEP(ldo, rdo);
-            }
-        }
-        DEBUG(std::cout << "<-3  delaunay( " << *begin << ", " << end[-1] << " ) : [ " << ldo << ", " << rdo << "]\n";)
-        RENDER_STEP(ldo, rdo);
-        return {ldo, rdo};
+    SDL_SetRenderDrawColor(graph_renderer, 0xFF, 0xFF, 0xFF, SDL_ALPHA_OPAQUE);
+    auto line = [&view, &points](std::uint32_t a, std::uint32_t b) {
+        SDL_Point from = to_pixel(view, points[a].x, points[a].y), to = to_pixel(view, points[b].x, points[b].y);
+        SDL_RenderDrawLine(graph_renderer, from.x, from.y, to.x, to.y);
+    };
+    for (auto [a, b] : replay.edges())
+        line(a, b);
+    if (const step *b = replay.base()) {
+        SDL_SetRenderDrawColor(graph_renderer, 0xFF, 0xFF, 0x00, SDL_ALPHA_OPAQUE);
+        line(b->a, b->b);
     }
+
+    SDL_SetRenderDrawColor(graph_renderer, 0xFF, 0x00, 0x00, SDL_ALPHA_OPAQUE);
+    draw_points(graph_renderer, points, view);
+    update_graph_texture();
 }
 
 const long long seed = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
@@ -275,6 +150,15 @@ std::uniform_real_distribution real;
 
 int main(int argc, char **argv) {
 
+    if (argc == 4 && argv[1] == "--stream"s) { // triangulate a file of points without opening a window
+        task_pool tasks;
+        bool written = stream_triangulate(tasks, argv[2], argv[3]);
+#ifdef INSTRUMENT
+        instrument_report(std::cout);
+#endif
+        return written ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         std::cout << "Can't initialize SDL: " << SDL_GetError() << std::endl;
         cleanup(window, window_renderer);
@@ -304,17 +188,29 @@ int main(int argc, char **argv) {
         std::printf("\t\t%s\n", SDL_GetPixelFormatName(info.texture_formats[i]));
     std::printf("\tmax texture size: %d x %d\n", info.max_texture_width, info.max_texture_height);
 
-    const int point_range = DEFAULT_WINDOW_HEIGHT;
-    graph_texture = SDL_CreateTexture(window_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, point_range, point_range);
-    SDL_Surface *surface;
+    const int texture_size = DEFAULT_WINDOW_HEIGHT;
+    graph_texture = SDL_CreateTexture(window_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, texture_size, texture_size);
+    graph_surface = SDL_CreateRGBSurfaceWithFormat(0, texture_size, texture_size, 32, SDL_PIXELFORMAT_ARGB8888);
+    graph_renderer = graph_surface ? SDL_CreateSoftwareRenderer(graph_surface) : NULL;
+    if (graph_texture == NULL || graph_renderer == NULL) {
+        std::cout << "Can't create graph texture: " << SDL_GetError() << std::endl;
+        cleanup(window, window_renderer);
+        return EXIT_FAILURE;
+    }
 
-    // generate points
-    // TODO make sure there are no duplicate points
+    // generate points, as many as asked for on the command line, over a square
+    // that grows with their number so they stay about as far apart
+    const int point_count = argc == 2 ? std::max(std::atoi(argv[1]), 2) : GENERATE_POINTS;
+    const int point_range = texture_size * std::max(1, int(std::sqrt(double(point_count) / GENERATE_POINTS)));
     std::vector<vertex> points;
     std::uniform_int_distribution range(0, point_range - 1);
-    for (int i = 0; i < GENERATE_POINTS; i++)
+    for (int i = 0; i < point_count; i++)
         points.push_back({range(random), range(random)});
 
+    // the whole square fits the texture until the view is zoomed or moved
+    const raster_view whole{double(texture_size) / point_range, 0, 0};
+    raster_view view = whole;
+
     // test case from Samuel Peterson
     // http://www.geom.uiuc.edu/~samuelp/del_project.html
     // const int demo_scale = point_range / 7;
@@ -324,30 +220,6 @@ int main(int argc, char **argv) {
     //     v.y = (v.y + 1) * demo_scale;
     // }
 
-    // compute triangulation
-    std::sort(points.begin(), points.end());
-    auto [l, r] = delaunay(points.begin(), points.end());
-    std::cout << "finished\n";
-
-    SDL_LockTextureToSurface(graph_texture, NULL, &surface);
-    SDL_Renderer *surface_renderer = SDL_CreateSoftwareRenderer(surface);
-    SDL_SetRenderDrawColor(surface_renderer, 0x00, 0x00, 0x00, SDL_ALPHA_OPAQUE);
-    SDL_RenderClear(surface_renderer);
-
-    // draw graph
-    SDL_SetRenderDrawColor(surface_renderer, 0xFF, 0xFF, 0xFF, SDL_ALPHA_OPAQUE);
-    draw_graph(surface_renderer, l, r);
-
-    // draw points
-    SDL_SetRenderDrawColor(surface_renderer, 0xFF, 0x00, 0x00, SDL_ALPHA_OPAQUE);
-    for (const vertex &v : points)
-        SDL_RenderDrawPoint(surface_renderer, v.x, v.y);
-
-    SDL_DestroyRenderer(surface_renderer);
-    SDL_UnlockTexture(graph_texture);
-
-    kill_graph(l);
-
     // initialize velocity effect
     std::uniform_int_distribution vel_range{-2, 2};
     for (vertex &v : points) {
@@ -355,6 +227,81 @@ int main(int argc, char **argv) {
         v.vy = vel_range(random);
     }
 
+    // compute triangulation
+    mesh_t graph;
+    task_pool tasks;
+    sort_unique(tasks, points); // duplicate points would break the merge
+#ifdef RENDER_STEP_ENABLE
+    // the window shows the steps as they come in and can go back and forth
+    // through them without holding up the build
+    step_queue<step> recorded_steps;
+    step_recorder<vertex> recorder(recorded_steps, points.data());
+    std::thread builder([&] {
+#ifdef PRINT_STEPS
+        trace_observer trace(std::cout);
+        observer_pair both(recorder, trace);
+        delaunay(graph, both, points.begin(), points.end());
+#else
+        delaunay(graph, recorder, points.begin(), points.end());
+#endif
+        recorded_steps.close();
+        std::cout << "finished\n";
+    });
+    step_replay replay;
+    bool recording = true, playing = false;
+    std::size_t speed = 1; // steps per frame while playing
+    draw_replay(replay, points, view);
+#else
+    cut_mode mode = cut_mode::vertical; // how rebuilds split the points, switched with c
+    edge_t r = parallel_delaunay(graph, tasks, points.begin(), points.end(), mode).second;
+    relayout(tasks, graph, points, r); // the mesh is drawn and walked over and over from now on
+    point_locator<vertex> locator(graph); // where adding and removing points starts looking
+    std::cout << "finished\n";
+
+    tile_raster raster;
+    voronoi_diagram cells; // cut out of the square of the points with a margin of its own size, found again once the mesh has changed
+    const voronoi_box cell_box{-double(point_range), -double(point_range), 2.0 * point_range, 2.0 * point_range};
+    bool cells_stale = true;
+    bool show_cells = false, show_tree = false;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> tree; // the minimum spanning tree, found again once the mesh has changed
+    bool tree_stale = true;
+    auto draw = [&] {
+        // draw graph, straight into the surface
+        raster.draw(tasks, graph, view, static_cast<std::uint32_t *>(graph_surface->pixels), graph_surface->pitch / 4, graph_surface->w, graph_surface->h,
+                    SDL_MapRGB(graph_surface->format, 0xFF, 0xFF, 0xFF), SDL_MapRGB(graph_surface->format, 0x00, 0x00, 0x00));
+
+        // draw voronoi cells, the ones in view
+        if (show_cells) {
+            if (cells_stale) {
+                cells.build(graph, points.data(), points.size(), cell_box);
+                cells_stale = false;
+            }
+            SDL_SetRenderDrawColor(graph_renderer, 0x00, 0x80, 0x00, SDL_ALPHA_OPAQUE);
+            draw_cells(graph_renderer, cells, view, {view.point_x(0), view.point_y(0), view.point_x(graph_surface->w), view.point_y(graph_surface->h)});
+        }
+
+        // draw minimum spanning tree
+        if (show_tree) {
+            if (tree_stale) {
+                tree = minimum_spanning_tree(graph, points.data(), points.size());
+                tree_stale = false;
+            }
+            SDL_SetRenderDrawColor(graph_renderer, 0xFF, 0xFF, 0x00, SDL_ALPHA_OPAQUE);
+            for (auto [a, b] : tree) {
+                SDL_Point from = to_pixel(view, points[a].x, points[a].y), to = to_pixel(view, points[b].x, points[b].y);
+                SDL_RenderDrawLine(graph_renderer, from.x, from.y, to.x, to.y);
+            }
+        }
+
+        // draw points
+        SDL_SetRenderDrawColor(graph_renderer, 0xFF, 0x00, 0x00, SDL_ALPHA_OPAQUE);
+        draw_points(graph_renderer, points, view);
+
+        update_graph_texture();
+    };
+    draw();
+#endif
+
     bool running = true;
     while (running) {
 
@@ -363,16 +310,55 @@ int main(int argc, char **argv) {
         SDL_RenderCopyEx(window_renderer, graph_texture, NULL, NULL, 0, 0, SDL_FLIP_VERTICAL);
         SDL_RenderPresent(window_renderer);
 
+#ifdef RENDER_STEP_ENABLE
+        if (recording)
+            recording = replay.fetch(recorded_steps);
+        if (playing) {
+            std::size_t at = replay.position();
+            replay.seek(at + speed);
+            if (replay.position() != at)
+                draw_replay(replay, points, view);
+            else if (!recording)
+                playing = false;
+        }
+        bool idle = !playing;
+#else
+        bool idle = true;
+#endif
+        if (idle)
+            SDL_WaitEvent(NULL); // sleep until there is something to do
+
+#ifndef RENDER_STEP_ENABLE
+        bool view_changed = false; // drawn once all events are in, however many moved it
+#endif
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT)
                 running = false;
 #ifndef RENDER_STEP_ENABLE
+            // the wheel zooms in and out around the mouse, and dragging moves the view
+            if (event.type == SDL_MOUSEWHEEL && event.wheel.y != 0) {
+                int mouse_x, mouse_y, window_width, window_height;
+                SDL_GetMouseState(&mouse_x, &mouse_y);
+                SDL_GetWindowSize(window, &window_width, &window_height);
+                double i = double(mouse_x) * texture_size / window_width, j = double(window_height - mouse_y) * texture_size / window_height; // flipped
+                double x = view.point_x(i), y = view.point_y(j);
+                view.scale = std::clamp(view.scale * std::pow(1.25, event.wheel.y), whole.scale / 4, 1000.0);
+                view.left = x - i / view.scale;
+                view.bottom = y - j / view.scale;
+                view_changed = true;
+            }
+            if (event.type == SDL_MOUSEMOTION && (event.motion.state & SDL_BUTTON_LMASK)) {
+                int window_width, window_height;
+                SDL_GetWindowSize(window, &window_width, &window_height);
+                view.left -= double(event.motion.xrel) * texture_size / window_width / view.scale;
+                view.bottom += double(event.motion.yrel) * texture_size / window_height / view.scale;
+                view_changed = true;
+            }
             if (event.type == SDL_KEYDOWN) {
-                SDL_LockTextureToSurface(graph_texture, NULL, &surface);
-                SDL_Renderer *surface_renderer = SDL_CreateSoftwareRenderer(surface);
-                SDL_SetRenderDrawColor(surface_renderer, 0x00, 0x00, 0x00, SDL_ALPHA_OPAQUE);
-                SDL_RenderClear(surface_renderer);
+                bool moved = true;    // points moved in place, the mesh can follow them
+                bool updated = false; // the mesh has already been brought up to date
+                bool changed = true;  // the picture needs to be drawn again
                 switch (event.key.keysym.sym) {
                     case SDLK_q: { // wiggle
                         for (vertex &v : points) {
@@ -406,31 +392,118 @@ int main(int argc, char **argv) {
                             v.y += v.vy;
                         }
                     } break;
-                    case SDLK_x: points.push_back({range(random), range(random)}); break;
-                    case SDLK_z: points.pop_back(); break;
+                    case SDLK_x: { // add a point, unless that moves the others in memory
+                        bool in_place = points.size() < points.capacity();
+                        points.push_back({range(random), range(random)});
+                        updated = in_place && insert_site(graph, r, &points.back(), locator.near(points.back(), r));
+                        tree_stale = true;
+                        cells_stale = true;
+                        moved = false;
+                    } break;
+                    case SDLK_z: {
+                        updated = points.size() > 3 && remove_site(graph, r, &points.back(), locator.near(points.back(), r));
+                        points.pop_back();
+                        tree_stale = true;
+                        cells_stale = true;
+                        moved = false;
+                    } break;
+                    case SDLK_p: { // save the triangulation
+                        if (export_mesh(graph, points.data(), points.size(), "triangulation.mesh"))
+                            std::cout << "saved triangulation.mesh\n";
+                        else
+                            std::cout << "Can't write triangulation.mesh\n";
+                        moved = false;
+                        updated = true;
+                        changed = false;
+                    } break;
+                    case SDLK_v: { // show the voronoi cells
+                        show_cells = !show_cells;
+                        moved = false;
+                        updated = true;
+                    } break;
+                    case SDLK_m: { // show the minimum spanning tree
+                        show_tree = !show_tree;
+                        moved = false;
+                        updated = true;
+                    } break;
+                    case SDLK_HOME: { // show all of the points again
+                        view = whole;
+                        moved = false;
+                        updated = true;
+                    } break;
+                    case SDLK_c: { // switch between vertical and alternating cuts
+                        mode = mode == cut_mode::vertical ? cut_mode::alternating : cut_mode::vertical;
+                        moved = false;
+                    } break;
+                    default: moved = false;
                 }
-                // recompute triangulation
-                std::sort(points.begin(), points.end());
-                auto [l, r] = delaunay(points.begin(), points.end());
-
-                // draw graph
-                SDL_SetRenderDrawColor(surface_renderer, 0xFF, 0xFF, 0xFF, SDL_ALPHA_OPAQUE);
-                draw_graph(surface_renderer, l, r);
-
-                // draw points
-                SDL_SetRenderDrawColor(surface_renderer, 0xFF, 0x00, 0x00, SDL_ALPHA_OPAQUE);
-                for (const vertex &v : points)
-                    SDL_RenderDrawPoint(surface_renderer, v.x, v.y);
-
-                SDL_DestroyRenderer(surface_renderer);
-                SDL_UnlockTexture(graph_texture);
-
-                kill_graph(l);
+                // update the triangulation, or recompute it if the points moved too far
+                if (moved) {
+                    updated = kinetic_update(graph, r);
+                    tree_stale = true;
+                    cells_stale = true;
+                }
+                if (!updated) {
+                    auto start = std::chrono::steady_clock::now();
+                    graph.clear();
+                    sort_unique(tasks, points);
+                    r = parallel_delaunay(graph, tasks, points.begin(), points.end(), mode).second;
+                    std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+                    std::cout << (mode == cut_mode::vertical ? "vertical" : "alternating") << " cuts: " << took.count() << " ms\n";
+                    relayout(tasks, graph, points, r);
+                    locator = point_locator<vertex>(graph);
+                    tree_stale = true;
+                    cells_stale = true;
+                }
+                if (changed)
+                    draw();
+            }
+#else
+            if (event.type == SDL_KEYDOWN) {
+                std::size_t at = replay.position();
+                const std::vector<std::size_t> &merges = replay.merge_steps();
+                switch (event.key.keysym.sym) {
+                    case SDLK_SPACE: replay.forward(); break;
+                    case SDLK_BACKSPACE: replay.back(); break;
+                    case SDLK_RIGHT: { // to the start of the next merge
+                        auto next = std::lower_bound(merges.begin(), merges.end(), at);
+                        replay.seek(next == merges.end() ? replay.size() : *next + 1);
+                    } break;
+                    case SDLK_LEFT: { // to the start of the merge before
+                        auto next = std::lower_bound(merges.begin(), merges.end(), at > 0 ? at - 1 : 0);
+                        replay.seek(next == merges.begin() ? 0 : next[-1] + 1);
+                    } break;
+                    case SDLK_HOME: replay.seek(0); break;
+                    case SDLK_END: replay.seek(replay.size()); break;
+                    case SDLK_RETURN: playing = !playing; break;
+                    case SDLK_UP: {
+                        speed *= 2;
+                        std::cout << speed << " steps per frame\n";
+                    } break;
+                    case SDLK_DOWN: {
+                        speed = std::max<std::size_t>(speed / 2, 1);
+                        std::cout << speed << " steps per frame\n";
+                    } break;
+                }
+                if (replay.position() != at)
+                    draw_replay(replay, points, view);
             }
 #endif
         }
+#ifndef RENDER_STEP_ENABLE
+        if (view_changed)
+            draw();
+#endif
     }
 
+#ifdef RENDER_STEP_ENABLE
+    builder.join();
+#endif
+    SDL_DestroyRenderer(graph_renderer);
+    SDL_FreeSurface(graph_surface);
     cleanup(window, window_renderer);
+#ifdef INSTRUMENT
+    instrument_report(std::cout);
+#endif
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A whole file mapped into memory. open() maps an existing file read only,
+// create() makes a new file of the given size, replacing any old one, and maps
+// it for writing. Both return false if that didn't work. The mapping goes away
+// with the object or on close().
+class mapped_file {
+  public:
+    mapped_file() = default;
+    ~mapped_file() { close(); }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    bool open(const char *path) { return map(path, 0, false); }
+    bool create(const char *path, std::size_t size) { return map(path, size, true); }
+
+    char *data() const { return base; }
+    std::size_t size() const { return length; }
+
+    void close() {
+#ifdef _WIN32
+        if (base)
+            UnmapViewOfFile(base);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (base)
+            munmap(base, length);
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+        base = nullptr;
+        length = 0;
+    }
+
+  private:
+    bool map(const char *path, std::size_t size, bool writable) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, writable ? 0 : FILE_SHARE_READ, NULL,
+                           writable ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        if (!writable) {
+            LARGE_INTEGER file_size;
+            if (!GetFileSizeEx(file, &file_size))
+                return close(), false;
+            size = std::size_t(file_size.QuadPart);
+        }
+        length = size;
+        if (size == 0) // empty files can't be mapped, but there is nothing to map either
+            return true;
+        mapping = CreateFileMappingA(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, DWORD(std::uint64_t(size) >> 32), DWORD(size), NULL);
+        if (!mapping)
+            return close(), false;
+        base = static_cast<char *>(MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size));
+#else
+        fd = ::open(path, writable ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+        if (fd < 0)
+            return false;
+        if (writable) {
+            if (ftruncate(fd, off_t(size)) != 0)
+                return close(), false;
+        } else {
+            struct stat info;
+            if (fstat(fd, &info) != 0)
+                return close(), false;
+            size = std::size_t(info.st_size);
+        }
+        length = size;
+        if (size == 0)
+            return true;
+        void *p = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        base = p == MAP_FAILED ? nullptr : static_cast<char *>(p);
+#endif
+        if (!base)
+            return close(), false;
+        return true;
+    }
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+    char *base = nullptr;
+    std::size_t length = 0;
+};
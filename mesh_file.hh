@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "flip.hh"
+#include "mapped_file.hh"
+#include "quad_edge.hh"
+
+// A flat binary form of a triangulation that can be memory mapped and used as
+// is. The file starts with a mesh_file_header, followed at the offsets it
+// gives by
+//   vertex_count vertices, each (x, y) as doubles,
+//   triangle_count triangles, each three vertex indices in counter-clockwise
+//     order, as 32 bit unsigned integers,
+//   triangle_count neighbor triples, where neighbor i of a triangle is the
+//     triangle across the edge opposite its vertex i, or no_triangle on the
+//     hull.
+// Everything is in the byte order of the machine that wrote it and aligned to
+// its size, so a reader that maps the file can cast the offsets to arrays.
+
+struct mesh_file_header {
+    char magic[8];          // "DELAUNAY"
+    std::uint32_t version;  // mesh_file_version
+    std::uint32_t reserved; // 0
+    std::uint64_t vertex_count;
+    std::uint64_t triangle_count;
+    std::uint64_t vertices; // byte offsets from the start of the file
+    std::uint64_t triangles;
+    std::uint64_t neighbors;
+};
+static_assert(sizeof(mesh_file_header) == 56, "mesh_file_header must not be padded");
+
+struct mesh_file_vertex {
+    double x, y;
+};
+
+constexpr char mesh_file_magic[8] = {'D', 'E', 'L', 'A', 'U', 'N', 'A', 'Y'};
+constexpr std::uint32_t mesh_file_version = 1;
+constexpr std::uint32_t no_triangle = 0xFFFFFFFF;
+
+// The arrays of a mapped mesh file.
+struct mesh_view {
+    const mesh_file_header *header = nullptr;
+    const mesh_file_vertex *vertices = nullptr;
+    const std::uint32_t (*triangles)[3] = nullptr;
+    const std::uint32_t (*neighbors)[3] = nullptr;
+};
+
+// Point view at the arrays in file. Returns false if file isn't a mesh file or
+// the arrays don't fit in it.
+inline bool view_mesh(const mapped_file &file, mesh_view &view) {
+    const mesh_file_header *header = reinterpret_cast<const mesh_file_header *>(file.data());
+    if (file.size() < sizeof(mesh_file_header) || std::memcmp(header->magic, mesh_file_magic, sizeof(mesh_file_magic)) != 0 ||
+        header->version != mesh_file_version)
+        return false;
+    auto fits = [&](std::uint64_t offset, std::uint64_t count, std::uint64_t size, std::uint64_t align) {
+        return offset % align == 0 && offset <= file.size() && count <= (file.size() - offset) / size;
+    };
+    if (!fits(header->vertices, header->vertex_count, sizeof(mesh_file_vertex), alignof(mesh_file_vertex)) ||
+        !fits(header->triangles, header->triangle_count, 3 * sizeof(std::uint32_t), alignof(std::uint32_t)) ||
+        !fits(header->neighbors, header->triangle_count, 3 * sizeof(std::uint32_t), alignof(std::uint32_t)))
+        return false;
+    view.header = header;
+    view.vertices = reinterpret_cast<const mesh_file_vertex *>(file.data() + header->vertices);
+    view.triangles = reinterpret_cast<const std::uint32_t(*)[3]>(file.data() + header->triangles);
+    view.neighbors = reinterpret_cast<const std::uint32_t(*)[3]>(file.data() + header->neighbors);
+    return true;
+}
+
+// Write the triangles of graph to path. Every vertex of the mesh must be one of
+// the count points starting at points, and vertex i of the file is points[i],
+// whether the mesh uses it or not. Returns false if the file can't be written.
+template <typename P> bool export_mesh(mesh<const P *> &graph, const P *points, std::size_t count, const char *path) {
+    using edge = edge_reference<const P *>;
+
+    // number the faces, remembering for every directed edge which triangle
+    // lies to its left
+    std::vector<std::uint32_t> triangle_of(std::size_t(graph.extent()) * 4, no_triangle);
+    std::vector<edge> first; // an edge of every triangle, from its vertex 0 to its vertex 1
+    graph.for_each_edge([&](edge q) {
+        for (edge d : {q, q.sym()}) {
+            if (triangle_of[d.h] != no_triangle || !left_triangle(d))
+                continue;
+            triangle_of[d.h] = triangle_of[d.l_next().h] = triangle_of[d.l_prev().h] = std::uint32_t(first.size());
+            first.push_back(d);
+        }
+    });
+
+    const std::size_t triangles = first.size();
+    mesh_file_header header = {};
+    std::memcpy(header.magic, mesh_file_magic, sizeof(mesh_file_magic));
+    header.version = mesh_file_version;
+    header.vertex_count = count;
+    header.triangle_count = triangles;
+    header.vertices = sizeof(mesh_file_header);
+    header.triangles = header.vertices + count * sizeof(mesh_file_vertex);
+    header.neighbors = header.triangles + triangles * 3 * sizeof(std::uint32_t);
+
+    mapped_file file;
+    if (!file.create(path, header.neighbors + triangles * 3 * sizeof(std::uint32_t)))
+        return false;
+    std::memcpy(file.data(), &header, sizeof(header));
+    mesh_file_vertex *vertices = reinterpret_cast<mesh_file_vertex *>(file.data() + header.vertices);
+    std::uint32_t(*corners)[3] = reinterpret_cast<std::uint32_t(*)[3]>(file.data() + header.triangles);
+    std::uint32_t(*neighbors)[3] = reinterpret_cast<std::uint32_t(*)[3]>(file.data() + header.neighbors);
+
+    for (std::size_t i = 0; i < count; i++)
+        vertices[i] = {double(points[i].x), double(points[i].y)};
+    for (std::size_t t = 0; t < triangles; t++) {
+        edge e[3] = {first[t].l_next(), first[t].l_prev(), first[t]}; // opposite vertex 0, 1 and 2
+        for (int i = 0; i < 3; i++) {
+            corners[t][i] = std::uint32_t(e[(i + 2) % 3].ORG - points);
+            neighbors[t][i] = triangle_of[e[i].sym().h];
+        }
+    }
+    return true;
+}
+
+// Rebuild the triangulation in the mesh file at path without retriangulating.
+// The vertices are read into points and the edges into graph, which is cleared
+// first, and outer is set to an edge with the outside of the hull on its left.
+// A file without triangles gives a mesh without edges, and outer is left alone.
+// Returns false if the file can't be read or the triangles don't fit together.
+template <typename P> bool load_mesh(const char *path, std::vector<P> &points, mesh<const P *> &graph, edge_reference<const P *> &outer) {
+    using edge = edge_reference<const P *>;
+
+    mapped_file file;
+    mesh_view view;
+    if (!file.open(path) || !view_mesh(file, view))
+        return false;
+    const std::size_t vertex_count = view.header->vertex_count, triangles = view.header->triangle_count;
+    if (vertex_count > no_triangle || triangles >= no_triangle)
+        return false;
+
+    // every vertex index must be in range, and every neighbor must have the
+    // same edge the other way around
+    auto opposite = [&](std::size_t t, int i) { return std::make_pair(view.triangles[t][(i + 1) % 3], view.triangles[t][(i + 2) % 3]); };
+    auto back = [&](std::size_t t, int i) {
+        std::uint32_t n = view.neighbors[t][i];
+        for (int j = 0; j < 3; j++)
+            if (view.neighbors[n][j] == t && opposite(n, j) == std::make_pair(opposite(t, i).second, opposite(t, i).first))
+                return j;
+        return -1;
+    };
+    for (std::size_t t = 0; t < triangles; t++) {
+        for (int i = 0; i < 3; i++) {
+            std::uint32_t n = view.neighbors[t][i];
+            if (view.triangles[t][i] >= vertex_count || (n != no_triangle && (n >= triangles || n == t || back(t, i) < 0)))
+                return false;
+        }
+    }
+
+    points.resize(vertex_count);
+    for (std::size_t i = 0; i < vertex_count; i++) {
+        points[i].x = decltype(P::x)(view.vertices[i].x);
+        points[i].y = decltype(P::y)(view.vertices[i].y);
+    }
+
+    // one edge for every pair of neighbors and for every hull side, then the
+    // edges are spliced together around each corner
+    graph.clear();
+    std::vector<edge_handle> sides(triangles * 3); // the edge opposite vertex i of triangle t, with t on its left
+    for (std::size_t t = 0; t < triangles; t++) {
+        for (int i = 0; i < 3; i++) {
+            std::uint32_t n = view.neighbors[t][i];
+            if (n != no_triangle && n < t) {
+                sides[t * 3 + i] = graph.ref(sides[n * 3 + back(t, i)]).sym().h;
+                continue;
+            }
+            edge e = make_edge(graph);
+            e.ORG = &points[opposite(t, i).first];
+            e.DEST = &points[opposite(t, i).second];
+            sides[t * 3 + i] = e.h;
+        }
+    }
+    for (std::size_t t = 0; t < triangles; t++) {
+        for (int i = 0; i < 3; i++) {
+            // the side from vertex i to the next is followed counter-clockwise
+            // around vertex i by the side to the one before it
+            edge x = graph.ref(sides[t * 3 + (i + 2) % 3]), y = graph.ref(sides[t * 3 + (i + 1) % 3]).sym();
+            if (x.o_next() != y)
+                splice(x, y.o_prev());
+        }
+    }
+    for (std::size_t s = 0; s < sides.size(); s++) {
+        if (view.neighbors[s / 3][s % 3] == no_triangle) {
+            outer = graph.ref(sides[s]).sym();
+            break;
+        }
+    }
+    return true;
+}
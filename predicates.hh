@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "instrument.hh"
+#include "quad_edge.hh"
+
+// Orientation and in-circle tests that are exact for int32, int64 and double
+// coordinates. Each test is first evaluated in plain double precision together
+// with a bound on its rounding error (Shewchuk's stage A filter); only when the
+// result is too close to zero to trust it, or when the coordinates can't be
+// represented as doubles in the first place, is the determinant evaluated again
+// with exact floating point expansion arithmetic, in fixed size arrays on the
+// stack, so even the exact tests never allocate.
+// Shewchuk, Adaptive Precision Floating-Point Arithmetic and Fast Robust
+// Geometric Predicates, https://www.cs.cmu.edu/~quake/robust.html
+
+namespace exact {
+
+constexpr double epsilon = std::numeric_limits<double>::epsilon() / 2;
+constexpr double splitter = 134217729.0; // 2^27 + 1
+constexpr double ccw_bound = (3.0 + 16.0 * epsilon) * epsilon;
+constexpr double in_circle_bound = (10.0 + 96.0 * epsilon) * epsilon;
+
+// x + y == a + b exactly, where x is the rounded sum.
+inline void two_sum(double a, double b, double &x, double &y) {
+    x = a + b;
+    double bv = x - a;
+    double av = x - bv;
+    y = (a - av) + (b - bv);
+}
+
+// x + y == a * b exactly, where x is the rounded product.
+inline void two_product(double a, double b, double &x, double &y) {
+    x = a * b;
+    double c = splitter * a;
+    double ahi = c - (c - a), alo = a - ahi;
+    c = splitter * b;
+    double bhi = c - (c - b), blo = b - bhi;
+    y = alo * blo - (((x - ahi * bhi) - alo * bhi) - ahi * blo);
+}
+
+// h = f + g (fast_expansion_sum_zeroelim), where f and g are expansions of fn
+// and gn components. h must have room for fn + gn. Returns the length of h.
+inline std::size_t sum_expansions(const double *f, std::size_t fn, const double *g, std::size_t gn, double *h) {
+    if (fn == 0 || gn == 0) {
+        const double *from = fn == 0 ? g : f;
+        std::size_t n = fn + gn;
+        std::copy(from, from + n, h);
+        return n;
+    }
+    std::size_t i = 0, j = 0, hn = 0;
+    auto next = [&] { return (j == gn || (i < fn && std::abs(f[i]) < std::abs(g[j]))) ? f[i++] : g[j++]; };
+    double q = next(), hh;
+    while (i < fn || j < gn) {
+        two_sum(q, next(), q, hh);
+        if (hh != 0)
+            h[hn++] = hh;
+    }
+    if (q != 0)
+        h[hn++] = q;
+    return hn;
+}
+
+// h = f * b (scale_expansion_zeroelim), where f is an expansion of fn
+// components. h must have room for 2 * fn. Returns the length of h.
+inline std::size_t scale_expansion(const double *f, std::size_t fn, double b, double *h) {
+    if (fn == 0 || b == 0)
+        return 0;
+    std::size_t hn = 0;
+    double q, hh, product1, product0, sum;
+    two_product(f[0], b, q, hh);
+    if (hh != 0)
+        h[hn++] = hh;
+    for (std::size_t i = 1; i < fn; i++) {
+        two_product(f[i], b, product1, product0);
+        two_sum(q, product0, sum, hh);
+        if (hh != 0)
+            h[hn++] = hh;
+        two_sum(product1, sum, q, hh); // product1 dominates sum, so this is a fast two sum
+        if (hh != 0)
+            h[hn++] = hh;
+    }
+    if (q != 0)
+        h[hn++] = q;
+    return hn;
+}
+
+// A number represented exactly as the sum of at most N non-overlapping
+// doubles, stored in order of increasing magnitude with zeroes eliminated.
+// The components live on the stack, and every operation returns an expansion
+// with room for as many components as its result can possibly have, so the
+// capacities follow from the formulas: the in-circle determinant, the largest,
+// needs room for 1536 components, a few kilobytes of stack.
+template <std::size_t N> struct expansion {
+    std::array<double, N> e;
+    std::size_t length = 0;
+
+    int sign() const { return length == 0 ? 0 : e[length - 1] > 0 ? 1 : -1; }
+
+    expansion operator-() const {
+        expansion r;
+        r.length = length;
+        for (std::size_t i = 0; i < length; i++)
+            r.e[i] = -e[i];
+        return r;
+    }
+};
+
+template <std::size_t N, std::size_t M> expansion<N + M> operator+(const expansion<N> &f, const expansion<M> &g) {
+    expansion<N + M> h;
+    h.length = sum_expansions(f.e.data(), f.length, g.e.data(), g.length, h.e.data());
+    return h;
+}
+
+template <std::size_t N, std::size_t M> expansion<N + M> operator-(const expansion<N> &f, const expansion<M> &g) { return f + -g; }
+
+template <std::size_t N, std::size_t M> expansion<2 * N * M> operator*(const expansion<N> &f, const expansion<M> &g) {
+    // add up f times every component of g, going back and forth between two
+    // partial sums
+    expansion<2 * N * M> h[2];
+    expansion<2 * N> term;
+    int current = 0;
+    for (std::size_t i = 0; i < g.length; i++) {
+        term.length = scale_expansion(f.e.data(), f.length, g.e[i], term.e.data());
+        h[1 - current].length = sum_expansions(h[current].e.data(), h[current].length, term.e.data(), term.length, h[1 - current].e.data());
+        current = 1 - current;
+    }
+    return h[current];
+}
+
+// Coordinates that convert to double without rounding can go through the
+// floating point filter; 64 bit integers beyond 2^53 skip straight to exact.
+template <typename C> bool representable(C c) {
+    if constexpr (std::is_integral_v<C> && sizeof(C) > 4)
+        return c >= -(C(1) << 53) && c <= (C(1) << 53);
+    else
+        return true;
+}
+
+// a - b exactly, which always fits in two components.
+template <typename C> expansion<2> difference(C a, C b) {
+    static_assert(std::is_arithmetic_v<C>, "coordinates must be integers or floating point numbers");
+    double x, y;
+    if constexpr (std::is_integral_v<C> && sizeof(C) > 4) {
+        // the differences of the high and the low halves are each exact as a double
+        std::int64_t u = a, v = b;
+        two_sum(double((u >> 32) - (v >> 32)) * 4294967296.0, double((u & 0xFFFFFFFF) - (v & 0xFFFFFFFF)), x, y);
+    } else {
+        two_sum(double(a), -double(b), x, y);
+    }
+    expansion<2> h;
+    if (y != 0)
+        h.e[h.length++] = y;
+    if (x != 0)
+        h.e[h.length++] = x;
+    return h;
+}
+
+template <typename P> int orient2d_exact(const P &a, const P &b, const P &c) {
+    expansion<2> acx = difference(a.x, c.x), acy = difference(a.y, c.y);
+    expansion<2> bcx = difference(b.x, c.x), bcy = difference(b.y, c.y);
+    return (acx * bcy - acy * bcx).sign();
+}
+
+template <typename P> int incircle_exact(const P &a, const P &b, const P &c, const P &d) {
+    expansion<2> adx = difference(a.x, d.x), ady = difference(a.y, d.y);
+    expansion<2> bdx = difference(b.x, d.x), bdy = difference(b.y, d.y);
+    expansion<2> cdx = difference(c.x, d.x), cdy = difference(c.y, d.y);
+    expansion<16> alift = adx * adx + ady * ady;
+    expansion<16> blift = bdx * bdx + bdy * bdy;
+    expansion<16> clift = cdx * cdx + cdy * cdy;
+    return (alift * (bdx * cdy - cdx * bdy) + blift * (cdx * ady - adx * cdy) + clift * (adx * bdy - bdx * ady)).sign();
+}
+
+} // namespace exact
+
+// Sign of the determinant
+// | a.x  a.y  1 |
+// | b.x  b.y  1 |
+// | c.x  c.y  1 |
+// positive if and only if the triangle a b c is oriented counter-clockwise.
+template <typename P> int orient2d(const P &a, const P &b, const P &c) {
+    if (exact::representable(a.x) && exact::representable(a.y) && exact::representable(b.x) && exact::representable(b.y) &&
+        exact::representable(c.x) && exact::representable(c.y)) {
+        double detleft = (double(a.x) - double(c.x)) * (double(b.y) - double(c.y));
+        double detright = (double(a.y) - double(c.y)) * (double(b.x) - double(c.x));
+        double det = detleft - detright;
+        double errbound = exact::ccw_bound * (std::abs(detleft) + std::abs(detright));
+        if (det > errbound)
+            return 1;
+        if (-det > errbound)
+            return -1;
+        if (detleft == 0 && detright == 0)
+            return 0;
+    }
+    return exact::orient2d_exact(a, b, c);
+}
+
+/* Sign of the determinant
+ * | a.x  a.y  a.x^2 + a.y^2  1 |
+ * | b.x  b.y  b.x^2 + b.y^2  1 |
+ * | c.x  c.y  c.x^2 + c.y^2  1 |
+ * | d.x  d.y  d.x^2 + d.y^2  1 |
+ * positive if and only if point D is interior to the region of the plane that
+ * is bounded by the oriented circle ABC and lies to the left of it.
+ * Translating d to the origin first reduces this to the 3x3 determinant
+ * | a.x-d.x  a.y-d.y  (a.x-d.x)^2 + (a.y-d.y)^2 |
+ * | b.x-d.x  b.y-d.y  (b.x-d.x)^2 + (b.y-d.y)^2 |
+ * | c.x-d.x  c.y-d.y  (c.x-d.x)^2 + (c.y-d.y)^2 |
+ */
+template <typename P> int incircle(const P &a, const P &b, const P &c, const P &d) {
+    if (exact::representable(a.x) && exact::representable(a.y) && exact::representable(b.x) && exact::representable(b.y) &&
+        exact::representable(c.x) && exact::representable(c.y) && exact::representable(d.x) && exact::representable(d.y)) {
+        double adx = double(a.x) - double(d.x), ady = double(a.y) - double(d.y);
+        double bdx = double(b.x) - double(d.x), bdy = double(b.y) - double(d.y);
+        double cdx = double(c.x) - double(d.x), cdy = double(c.y) - double(d.y);
+
+        double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy, alift = adx * adx + ady * ady;
+        double cdxady = cdx * ady, adxcdy = adx * cdy, blift = bdx * bdx + bdy * bdy;
+        double adxbdy = adx * bdy, bdxady = bdx * ady, clift = cdx * cdx + cdy * cdy;
+
+        double det = alift * (bdxcdy - cdxbdy) + blift * (cdxady - adxcdy) + clift * (adxbdy - bdxady);
+        double permanent = (std::abs(bdxcdy) + std::abs(cdxbdy)) * alift + (std::abs(cdxady) + std::abs(adxcdy)) * blift +
+                           (std::abs(adxbdy) + std::abs(bdxady)) * clift;
+        double errbound = exact::in_circle_bound * permanent;
+        if (det > errbound)
+            return 1;
+        if (-det > errbound)
+            return -1;
+    }
+    return exact::incircle_exact(a, b, c, d);
+}
+
+// true if and only if point d is inside the circle through a b c (taken
+// counter-clockwise).
+template <typename P> bool in_circle(const P &a, const P &b, const P &c, const P &d) {
+    INSTRUMENT_COUNT(in_circle);
+    return incircle(a, b, c, d) > 0;
+}
+
+// true if the triangle a b c is oriented counter-clockwise.
+template <typename P> bool ccw(const P &a, const P &b, const P &c) {
+    INSTRUMENT_COUNT(ccw);
+    return orient2d(a, b, c) > 0;
+}
+template <typename P> bool right_of(const P &x, edge_reference<const P *> e) { return ccw(x, *e.DEST, *e.ORG); }
+template <typename P> bool left_of(const P &x, edge_reference<const P *> e) { return ccw(x, *e.ORG, *e.DEST); }
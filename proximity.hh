@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "quad_edge.hh"
+#include "task_pool.hh"
+
+// Queries that come for free with a Delaunay triangulation, since the graphs
+// they are about are subgraphs of it: the nearest neighbour of every point is
+// joined to it by a Delaunay edge, and so is every edge of the Euclidean
+// minimum spanning tree. Points are numbered by where they are in the array
+// starting at points, which every vertex of the mesh must be in. Distances are
+// compared as squared distances in double precision, and ties go to the lower
+// index, so the answers don't depend on how the mesh happens to be laid out.
+
+constexpr std::uint32_t no_point = 0xFFFFFFFF;
+
+template <typename P> double squared_distance(const P &a, const P &b) {
+    double dx = double(a.x) - double(b.x), dy = double(a.y) - double(b.y);
+    return dx * dx + dy * dy;
+}
+
+// An edge out of every one of the count points, or an edge with no mesh for
+// points that aren't in graph.
+template <typename P> std::vector<edge_reference<const P *>> edges_out(mesh<const P *> &graph, const P *points, std::size_t count) {
+    std::vector<edge_reference<const P *>> out(count, edge_reference<const P *>{nullptr, 0});
+    graph.for_each_edge([&](edge_reference<const P *> e) {
+        out[e.ORG - points] = e;
+        out[e.DEST - points] = e.sym();
+    });
+    return out;
+}
+
+// The index of the nearest other point of every one of the count points, or
+// no_point for points that aren't joined to any other. Every point only looks
+// at the ring of edges around it, so the points are shared out among tasks.
+template <typename P> std::vector<std::uint32_t> nearest_neighbors(task_pool &tasks, mesh<const P *> &graph, const P *points, std::size_t count) {
+    const std::vector<edge_reference<const P *>> out = edges_out(graph, points, count);
+    std::vector<std::uint32_t> nearest(count, no_point);
+    tasks.parallel_for(0, count, 4096, [&](std::size_t i) {
+        if (!out[i].m)
+            return;
+        double best = 0;
+        edge_reference<const P *> e = out[i];
+        do {
+            std::uint32_t j = std::uint32_t(e.DEST - points);
+            double d = squared_distance(points[i], *e.DEST);
+            if (nearest[i] == no_point || d < best || (d == best && j < nearest[i])) {
+                nearest[i] = j;
+                best = d;
+            }
+            e = e.o_next();
+        } while (e != out[i]);
+    });
+    return nearest;
+}
+
+// Sets of points that can be merged, by union by size and path halving.
+class disjoint_sets {
+  public:
+    explicit disjoint_sets(std::size_t n) : parent(n), size(n, 1) {
+        for (std::size_t i = 0; i < n; i++)
+            parent[i] = std::uint32_t(i);
+    }
+
+    std::uint32_t find(std::uint32_t i) {
+        while (parent[i] != i)
+            i = parent[i] = parent[parent[i]];
+        return i;
+    }
+
+    // Merge the sets of a and b. Returns false if they already were the same.
+    bool unite(std::uint32_t a, std::uint32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a == b)
+            return false;
+        if (size[a] < size[b])
+            std::swap(a, b);
+        parent[b] = a;
+        size[a] += size[b];
+        return true;
+    }
+
+  private:
+    std::vector<std::uint32_t> parent;
+    std::vector<std::uint32_t> size;
+};
+
+// The edges of the Euclidean minimum spanning tree of the points of graph, as
+// pairs of indices with the lower one first, shortest first. Kruskal's
+// algorithm over the edges of the mesh: every edge, from the shortest up,
+// is kept if it joins two points that aren't connected yet. A mesh of
+// several pieces gives a spanning forest.
+template <typename P> std::vector<std::pair<std::uint32_t, std::uint32_t>> minimum_spanning_tree(mesh<const P *> &graph, const P *points, std::size_t count) {
+    struct candidate {
+        double length; // squared
+        std::uint32_t a, b;
+        bool operator<(const candidate &rhs) const { return length != rhs.length ? length < rhs.length : a != rhs.a ? a < rhs.a : b < rhs.b; }
+    };
+    std::vector<candidate> edges;
+    edges.reserve(graph.size());
+    graph.for_each_edge([&](edge_reference<const P *> e) {
+        std::uint32_t a = std::uint32_t(e.ORG - points), b = std::uint32_t(e.DEST - points);
+        edges.push_back({squared_distance(*e.ORG, *e.DEST), std::min(a, b), std::max(a, b)});
+    });
+    std::sort(edges.begin(), edges.end());
+
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> tree;
+    disjoint_sets sets(count);
+    for (const candidate &c : edges) {
+        if (!sets.unite(c.a, c.b))
+            continue;
+        tree.push_back({c.a, c.b});
+        if (tree.size() + 1 == count) // spanning already
+            break;
+    }
+    return tree;
+}
@@ -1,9 +1,16 @@
+#pragma once
 
 #include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <ostream>
+#include <utility>
 #include <vector>
 
+#include "instrument.hh"
+
 inline unsigned modulo(int a, int b) {
     int m = a % b;
     if (m < 0)
@@ -11,18 +18,28 @@ inline unsigned modulo(int a, int b) {
     return m;
 }
 
-template <typename T> struct quad_edge;
+// Edges are addressed by a packed 32 bit handle: the index of their quad_edge
+// in the mesh shifted left by two, or'd with the rotation with respect to the
+// canonical edge. This is all a quad_edge stores to link to its neighbours.
+using edge_handle = std::uint32_t;
+
+template <typename T> class mesh;
 
 template <typename T> struct edge_reference {
-    quad_edge<T> *q; // parent edge group
-    unsigned r;      // rotation with respect to canonincal edge
-    T &data() { return q->e[r].data; }
+    mesh<T> *m;    // mesh holding the edge
+    edge_handle h; // quad_edge index << 2 | rotation
+
+    std::uint32_t index() const { return h >> 2; }
+    unsigned r() const { return h & 3; }
+
+    // Only the primal edges (even rotations) carry data.
+    T &data() const; // see below
 
-    bool operator==(const edge_reference<T> &rhs) const { return q == rhs.q && r == rhs.r; }
+    bool operator==(const edge_reference<T> &rhs) const { return h == rhs.h && m == rhs.m; }
     bool operator!=(const edge_reference<T> &rhs) const { return !(*this == rhs); }
-    friend std::ostream &operator<<(std::ostream &lhs, const edge_reference<T> &rhs) { return lhs << rhs.q << '[' << rhs.r << ']'; }
+    friend std::ostream &operator<<(std::ostream &lhs, const edge_reference<T> &rhs) { return lhs << rhs.index() << '[' << rhs.r() << ']'; }
 
-    edge_reference<T> rot(int n = 1) const { return {q, modulo(r + n, 4)}; }
+    edge_reference<T> rot(int n = 1) const { return {m, (h & ~3u) | ((h + unsigned(n)) & 3u)}; }
     edge_reference<T> sym() const { return rot(2); }
 
     edge_reference<T> o_next() const; // see below
@@ -36,14 +53,203 @@ template <typename T> struct edge_reference {
     edge_reference<T> d_prev() const { return rot(-1).o_next().rot(-1); }
 };
 
-template <typename T> struct quarter_record {
-    edge_reference<T> next;
-    T data;
+// The four quarter records of an edge are reduced to their Onext handles. The
+// dual edges (rotations 1 and 3) carry no data, so only the origins of e[0]
+// and e[2] are kept. With T a pointer this is 32 bytes per edge group.
+template <typename T> struct quad_edge {
+    edge_handle next[4]; // e[r] Onext
+    T data[2];           // e[0] Org and e[2] Org
+};
+
+template <typename T> class edge_slab;
+
+// Owns the quad_edges of a subdivision, stored contiguously and addressed by
+// index. Deleted edges are recycled through a free list threaded through their
+// next[0] handles, so once the mesh has warmed up make_edge and delete_edge
+// never touch the general purpose allocator. clear() throws away every edge at
+// once without visiting any of them and keeps the storage for the next
+// subdivision built in the mesh.
+template <typename T> class mesh {
+  public:
+    using value_type = T;
+
+    static constexpr std::uint32_t no_edge = 0xFFFFFFFF;
+    static constexpr std::size_t max_size = (std::size_t(1) << 30) - 1; // room for the rotation in an edge_handle
+
+    mesh() = default;
+    mesh(const mesh &) = delete;
+    mesh &operator=(const mesh &) = delete;
+
+    quad_edge<T> &operator[](std::uint32_t i) { return edges[i]; }
+    const quad_edge<T> &operator[](std::uint32_t i) const { return edges[i]; }
+
+    edge_reference<T> ref(edge_handle h) { return {this, h}; }
+
+    edge_reference<T> allocate() {
+        ++live;
+        if (free_list != no_edge) {
+            std::uint32_t i = free_list;
+            free_list = edges[i].next[0];
+            return {this, i << 2};
+        }
+        assert(edges.size() < max_size);
+        edges.emplace_back();
+        return {this, std::uint32_t(edges.size() - 1) << 2};
+    }
+
+    void release(edge_reference<T> e) {
+        --live;
+        edges[e.index()].next[0] = free_list;
+        edges[e.index()].next[1] = no_edge; // marks the quad_edge as free
+        free_list = e.index();
+    }
+
+    // Reserve n contiguous quad_edges to be carved up by edge_slabs and return
+    // the index of the first one. Whatever the slabs end up holding is handed
+    // back to the mesh with adopt(). Nothing else may allocate from the mesh
+    // while slabs are in use, since that could move the storage under them.
+    std::uint32_t allocate_block(std::size_t n) {
+        assert(edges.size() + n <= max_size);
+        std::uint32_t first = edges.size();
+        edges.resize(edges.size() + n);
+        return first;
+    }
+
+    void adopt(edge_slab<T> &slab); // see below
+
+    // Move the live quad_edges to the front of the storage in the order given,
+    // order[k] being the index of the quad_edge to go to index k, and rewrite
+    // every link to match. order must list every live quad_edge once. Returns
+    // the new index of every old one, or no_edge for those that were free;
+    // handles kept outside the mesh have to be translated with it.
+    std::vector<std::uint32_t> reorder(const std::vector<std::uint32_t> &order) {
+        assert(order.size() == live);
+        std::vector<std::uint32_t> moved(edges.size(), no_edge);
+        for (std::uint32_t k = 0; k < order.size(); k++)
+            moved[order[k]] = k;
+        std::vector<quad_edge<T>> reordered(order.size());
+        for (std::uint32_t k = 0; k < order.size(); k++) {
+            quad_edge<T> q = edges[order[k]];
+            for (edge_handle &n : q.next)
+                n = moved[n >> 2] << 2 | (n & 3);
+            reordered[k] = q;
+        }
+        edges.swap(reordered);
+        free_list = no_edge;
+        return moved;
+    }
+
+    // Discard every edge in the mesh in O(1).
+    void clear() {
+        edges.clear();
+        live = 0;
+        free_list = no_edge;
+    }
+
+    std::size_t size() const { return live; } // number of live quad_edges
+
+    // One past the largest index a quad_edge in the mesh can have.
+    std::uint32_t extent() const { return edges.size(); }
+
+    // Call f with the canonical edge_reference of every live quad_edge.
+    template <typename F> void for_each_edge(F f) {
+        for (std::uint32_t i = 0; i < edges.size(); i++)
+            if (edges[i].next[1] != no_edge)
+                f(edge_reference<T>{this, i << 2});
+    }
+
+  private:
+    std::vector<quad_edge<T>> edges;
+    std::size_t live = 0;
+    std::uint32_t free_list = no_edge;
 };
 
-template <typename T> struct quad_edge { quarter_record<T> e[4]; };
+template <typename T> T &edge_reference<T>::data() const {
+    assert(r() % 2 == 0);
+    return (*m)[index()].data[r() >> 1];
+}
+
+template <typename T> edge_reference<T> edge_reference<T>::o_next() const { return {m, (*m)[index()].next[r()]}; }
+
+// A private range of a mesh's storage for one subproblem of a parallel build.
+// Slabs never share quad_edges, so subproblems running on different threads can
+// make and delete edges without any synchronisation. A planar graph on n points
+// has fewer than 3n edges, so a subproblem over n points never needs more than
+// a slab of 3n quad_edges as long as it reuses the ones it deletes. Since where
+// a slab lies only depends on the subproblem, the edges come out the same no
+// matter how many threads did the work.
+template <typename T> class edge_slab {
+  public:
+    using value_type = T;
+
+    edge_slab(mesh<T> &m, std::uint32_t begin, std::uint32_t end) : m(&m), next(begin), end(end) {}
+
+    edge_reference<T> allocate() {
+        ++live;
+        if (free_head != mesh<T>::no_edge) {
+            std::uint32_t i = free_head;
+            free_head = (*m)[i].next[0];
+            if (free_head == mesh<T>::no_edge)
+                free_tail = mesh<T>::no_edge;
+            return {m, i << 2};
+        }
+        assert(next != end);
+        return {m, next++ << 2};
+    }
+
+    void release(edge_reference<T> e) {
+        --live;
+        push_free(e.index());
+    }
+
+    // Hand the first n unused quad_edges of this slab to a new slab.
+    edge_slab split(std::size_t n) {
+        assert(n <= end - next);
+        next += n;
+        return {*m, std::uint32_t(next - n), next};
+    }
+
+    // Take back everything a slab split off from this one holds.
+    void absorb(edge_slab &other) {
+        for (; other.next != other.end; ++other.next)
+            push_free(other.next);
+        if (other.free_head != mesh<T>::no_edge) {
+            (*m)[other.free_tail].next[0] = free_head;
+            if (free_head == mesh<T>::no_edge)
+                free_tail = other.free_tail;
+            free_head = other.free_head;
+        }
+        live += other.live;
+        other.free_head = other.free_tail = mesh<T>::no_edge;
+        other.live = 0;
+    }
+
+  private:
+    friend class mesh<T>;
+
+    void push_free(std::uint32_t i) {
+        (*m)[i].next[0] = free_head;
+        (*m)[i].next[1] = mesh<T>::no_edge;
+        if (free_head == mesh<T>::no_edge)
+            free_tail = i;
+        free_head = i;
+    }
 
-template <typename T> edge_reference<T> edge_reference<T>::o_next() const { return q->e[r].next; }
+    mesh<T> *m;
+    std::uint32_t next, end; // never used quad_edges
+    std::uint32_t free_head = mesh<T>::no_edge, free_tail = mesh<T>::no_edge;
+    std::size_t live = 0;
+};
+
+template <typename T> void mesh<T>::adopt(edge_slab<T> &slab) {
+    edge_slab<T> rest(*this, 0, 0);
+    rest.absorb(slab);
+    if (rest.free_head != no_edge) {
+        edges[rest.free_tail].next[0] = free_list;
+        free_list = rest.free_head;
+    }
+    live += rest.live;
+}
 
 // From Guibas & Stolfi:
 // returns an edge e of a newly created data structure representing a
@@ -53,13 +259,17 @@ template <typename T> edge_reference<T> edge_reference<T>::o_next() const { retu
 // e Onext = e Oprev = e. To construct a loop, we may use e = make_edge().rot();
 // then we will have e Org = e Dest, e Left != e Right, e Lnext = e Rnext = e,
 // and e Onext = e Oprev = e Sym.
-template <typename T> edge_reference<T> make_edge() {
-    quad_edge<T> *q = new quad_edge<T>;
-    q->e[0].next = {q, 0}; // e0 Onext = e0
-    q->e[1].next = {q, 3}; // e1 Onext = e1 sym = e0 rot3
-    q->e[2].next = {q, 2}; // e2 Onext = e2     = e0 rot2
-    q->e[3].next = {q, 1}; // e3 Onext = e3 sym = e0 rot1
-    return {q, 0};         // canonical edge reference
+// The quad_edge is taken from pool, which is either a mesh or an edge_slab.
+template <typename Pool> edge_reference<typename Pool::value_type> make_edge(Pool &pool) {
+    using T = typename Pool::value_type;
+    INSTRUMENT_COUNT(made);
+    edge_reference<T> e = pool.allocate();
+    quad_edge<T> &q = (*e.m)[e.index()];
+    q.next[0] = e.h;     // e0 Onext = e0
+    q.next[1] = e.h | 3; // e1 Onext = e1 sym = e0 rot3
+    q.next[2] = e.h | 2; // e2 Onext = e2     = e0 rot2
+    q.next[3] = e.h | 1; // e3 Onext = e3 sym = e0 rot1
+    return e;            // canonical edge reference
 }
 
 // From Guibas & Stolfi:
@@ -80,10 +290,11 @@ template <typename T> void splice(edge_reference<T> a, edge_reference<T> b) {
     edge_reference<T> alph_o_temp = alph.o_next();
     edge_reference<T> beta_o_temp = beta.o_next();
 
-    a.q->e[a.r].next = b_o_temp;          // a Onext <- b Onext
-    b.q->e[b.r].next = a_o_temp;          // b Onext <- a Onext
-    alph.q->e[alph.r].next = beta_o_temp; // alph Onext <- beta Onext
-    beta.q->e[beta.r].next = alph_o_temp; // beta Onext <- alph Onext
+    mesh<T> &m = *a.m;
+    m[a.index()].next[a.r()] = b_o_temp.h;          // a Onext <- b Onext
+    m[b.index()].next[b.r()] = a_o_temp.h;          // b Onext <- a Onext
+    m[alph.index()].next[alph.r()] = beta_o_temp.h; // alph Onext <- beta Onext
+    m[beta.index()].next[beta.r()] = alph_o_temp.h; // beta Onext <- alph Onext
 }
 
 #define ORG data()
@@ -93,8 +304,8 @@ template <typename T> void splice(edge_reference<T> a, edge_reference<T> b) {
 // a way that a Left = e Left = b Left after the connection is complete. For
 // added convenience it will also set the Org and Dest fields of the new edge
 // to a.Dest and b.Org, respectively.
-template <typename T> edge_reference<T> connect(edge_reference<T> a, edge_reference<T> b) {
-    edge_reference e = make_edge<T>();
+template <typename Pool, typename T> edge_reference<T> connect(Pool &pool, edge_reference<T> a, edge_reference<T> b) {
+    edge_reference e = make_edge(pool);
     e.ORG = a.DEST;
     e.DEST = b.ORG;
     splice(e, a.l_next());
@@ -104,36 +315,36 @@ template <typename T> edge_reference<T> connect(edge_reference<T> a, edge_refere
 
 // Disconnect the edge e from the rest of the structure (this may cause the rest
 // of the structure to fall apart in two separate components) and free the
-// associated quad_edge. In a sense, delete_edge is the inverse of connect.
-template <typename T> void delete_edge(edge_reference<T> &e) {
+// associated quad_edge back to its pool. In a sense, delete_edge is the inverse
+// of connect. Whole subdivisions are torn down with mesh::clear instead.
+template <typename Pool, typename T> void delete_edge(Pool &pool, edge_reference<T> &e) {
+    INSTRUMENT_COUNT(deleted);
     splice(e, e.o_prev());
     splice(e.sym(), e.sym().o_prev());
-    delete e.q;
-    e.q = nullptr;
+    pool.release(e);
+    e.m = nullptr;
 }
 
-// Delete the entire structure of the graph connected to this edge.
-template <typename T> void kill_graph(edge_reference<T> edge) {
-    std::unordered_set<quad_edge<T> *> deleted;
-    std::deque<edge_reference<T>> edge_queue;
-    edge_queue.push_back(edge);
-    while (!edge_queue.empty()) {
-        edge_reference<T> e = edge_queue.front();
-        edge_queue.pop_front();
-        if (deleted.insert(e.q).second) { // e hasn't been deleted
-            edge_queue.push_back(e.o_next());
-            edge_queue.push_back(e.sym().o_next());
-            delete_edge(e);
-        }
-    }
+// From Guibas & Stolfi:
+// Turn e counterclockwise inside the quadrilateral formed by the two faces on
+// either side of it, so that it connects the other two corners. The faces must
+// be triangles and the quadrilateral convex.
+template <typename T> void swap(edge_reference<T> e) {
+    edge_reference<T> a = e.o_prev();
+    edge_reference<T> b = e.sym().o_prev();
+    splice(e, a);
+    splice(e.sym(), b);
+    splice(e, a.l_next());
+    splice(e.sym(), b.l_next());
+    e.ORG = a.DEST;
+    e.DEST = b.DEST;
 }
 
 namespace std {
 template <typename T> struct hash<edge_reference<T>> {
     std::size_t operator()(const edge_reference<T> &e) const noexcept {
-        // hash collisions should never happen since e.r never exceeds 3,
-        // which will be less than the size allocated for a quad_edge.
-        return ((std::size_t)e.q) + (e.r);
+        // handles are unique within a mesh
+        return std::hash<edge_handle>()(e.h) ^ std::hash<const void *>()(e.m);
     }
 };
 } // namespace std
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "task_pool.hh"
+
+// Sorting the points by x, then y, is the first step of every triangulation.
+// Instead of a comparison sort the coordinates are packed into a 64 bit key
+// that orders the same way and sorted with a parallel LSD radix sort, one byte
+// per pass. Coordinates are taken relative to the lowest ones, and passes over
+// bytes that are the same in every key (the high bytes when the points span a
+// small range) are skipped. Coordinates must be integers of at most 32 bits.
+
+// Maps an integer coordinate to an unsigned one in the same order.
+template <typename C> std::uint32_t radix_coordinate(C c) {
+    static_assert(std::is_integral_v<C> && sizeof(C) <= 4, "radix sorting needs integer coordinates of at most 32 bits");
+    if constexpr (std::is_signed_v<C>)
+        return std::uint32_t(std::int32_t(c)) ^ 0x80000000u;
+    else
+        return std::uint32_t(c);
+}
+
+// Sort points by x, then y, and remove points with the same coordinates as an
+// earlier one, keeping the first. Returns, for every index into points as it
+// was passed in, the index of its point after sorting, so attributes kept
+// outside of the points can be carried along.
+template <typename P> std::vector<std::uint32_t> sort_unique(task_pool &tasks, std::vector<P> &points) {
+    struct item {
+        std::uint64_t key;
+        std::uint32_t index;
+    };
+    const std::size_t n = points.size();
+    const std::size_t chunks = std::max<std::size_t>(1, std::min<std::size_t>(tasks.size() * 4, n / 4096));
+    auto chunk_begin = [n, chunks](std::size_t c) { return n * c / chunks; };
+
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> lowest(chunks, {~0u, ~0u});
+    tasks.parallel_for(0, chunks, 1, [&](std::size_t c) {
+        for (std::size_t i = chunk_begin(c); i < chunk_begin(c + 1); i++) {
+            lowest[c].first = std::min(lowest[c].first, radix_coordinate(points[i].x));
+            lowest[c].second = std::min(lowest[c].second, radix_coordinate(points[i].y));
+        }
+    });
+    std::uint32_t min_x = ~0u, min_y = ~0u;
+    for (auto [x, y] : lowest)
+        min_x = std::min(min_x, x), min_y = std::min(min_y, y);
+
+    std::vector<item> a(n), b(n);
+    std::vector<std::uint64_t> bits(chunks, 0);
+    tasks.parallel_for(0, chunks, 1, [&](std::size_t c) {
+        for (std::size_t i = chunk_begin(c); i < chunk_begin(c + 1); i++) {
+            std::uint64_t key = std::uint64_t(radix_coordinate(points[i].x) - min_x) << 32 | (radix_coordinate(points[i].y) - min_y);
+            a[i] = {key, std::uint32_t(i)};
+            bits[c] |= key;
+        }
+    });
+    std::uint64_t varying = 0;
+    for (std::uint64_t k : bits)
+        varying |= k;
+
+    // each pass counts the digits in every chunk, then lets every chunk
+    // scatter its items to where the counts of everything before it end
+    std::vector<std::size_t> offsets(chunks * 256);
+    for (unsigned shift = 0; shift < 64; shift += 8) {
+        if (((varying >> shift) & 0xFF) == 0)
+            continue;
+        tasks.parallel_for(0, chunks, 1, [&](std::size_t c) {
+            std::size_t *count = &offsets[c * 256];
+            std::fill_n(count, 256, 0);
+            for (std::size_t i = chunk_begin(c); i < chunk_begin(c + 1); i++)
+                count[(a[i].key >> shift) & 0xFF]++;
+        });
+        std::size_t sum = 0;
+        for (std::size_t digit = 0; digit < 256; digit++) {
+            for (std::size_t c = 0; c < chunks; c++) {
+                std::size_t count = offsets[c * 256 + digit];
+                offsets[c * 256 + digit] = sum;
+                sum += count;
+            }
+        }
+        tasks.parallel_for(0, chunks, 1, [&](std::size_t c) {
+            std::size_t *offset = &offsets[c * 256];
+            for (std::size_t i = chunk_begin(c); i < chunk_begin(c + 1); i++)
+                b[offset[(a[i].key >> shift) & 0xFF]++] = a[i];
+        });
+        std::swap(a, b);
+    }
+
+    // the sort is stable, so the first of a run of equal keys is the one that
+    // came first in the input
+    std::vector<std::size_t> first_unique(chunks + 1, 0);
+    tasks.parallel_for(0, chunks, 1, [&](std::size_t c) {
+        for (std::size_t i = chunk_begin(c); i < chunk_begin(c + 1); i++)
+            first_unique[c + 1] += i == 0 || a[i].key != a[i - 1].key;
+    });
+    for (std::size_t c = 0; c < chunks; c++)
+        first_unique[c + 1] += first_unique[c];
+
+    std::vector<P> unique(first_unique[chunks]);
+    std::vector<std::uint32_t> mapping(n);
+    tasks.parallel_for(0, chunks, 1, [&](std::size_t c) {
+        std::size_t u = first_unique[c] - 1; // wraps around if the chunk starts a new key, which it does at 0
+        for (std::size_t i = chunk_begin(c); i < chunk_begin(c + 1); i++) {
+            if (i == 0 || a[i].key != a[i - 1].key)
+                unique[++u] = points[a[i].index];
+            mapping[a[i].index] = std::uint32_t(u);
+        }
+    });
+    points.swap(unique);
+    return mapping;
+}
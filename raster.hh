@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "quad_edge.hh"
+#include "task_pool.hh"
+
+// Drawing the edges of a mesh straight into 32 bit pixels, on all cores. The
+// picture is cut into square tiles and every edge is binned into the tiles it
+// may cross, in parallel over ranges of the mesh's storage, much like the
+// passes of the radix sort. Then every tile is drawn on its own, so no two
+// threads ever write the same pixel. Whether a pixel is on an edge only
+// depends on the edge, not on the tile it is drawn in, so there are no seams.
+//
+// An edge shorter than a pixel isn't drawn as a line. Its length is added to
+// the coverage of the pixel it is in instead, and every pixel is shaded by how
+// much edge there is in it. Zoomed out far enough that most edges are shorter
+// than a pixel, the mesh turns into a picture of its density, at the cost of
+// one addition per edge.
+
+// Which part of the plane the pixels show: pixel (i, j) covers the square of
+// side 1 / scale whose lower left corner is (left + i / scale, bottom + j / scale).
+struct raster_view {
+    double scale = 1; // pixels per unit
+    double left = 0, bottom = 0;
+
+    double pixel_x(double x) const { return (x - left) * scale; }
+    double pixel_y(double y) const { return (y - bottom) * scale; }
+    double point_x(double i) const { return left + i / scale; }
+    double point_y(double j) const { return bottom + j / scale; }
+};
+
+class tile_raster {
+  public:
+    static constexpr int tile_size = 64;
+
+    // Draw the edges of graph in line_color on background into the width by
+    // height pixels starting at pixels, which are pitch pixels apart from one
+    // row to the next.
+    template <typename P>
+    void draw(task_pool &tasks, mesh<const P *> &graph, raster_view view, std::uint32_t *pixels, int pitch, int width, int height, std::uint32_t line_color,
+              std::uint32_t background);
+
+  private:
+    std::vector<std::size_t> offsets; // where the edges a range puts in a tile go in bins, by tile, then range
+    std::vector<std::size_t> starts;  // the edges of tile t are bins[starts[t], starts[t + 1])
+    std::vector<std::uint32_t> bins;  // quad_edge indices
+};
+
+template <typename P>
+void tile_raster::draw(task_pool &tasks, mesh<const P *> &graph, raster_view view, std::uint32_t *pixels, int pitch, int width, int height,
+                       std::uint32_t line_color, std::uint32_t background) {
+    const int columns = (width + tile_size - 1) / tile_size, rows = (height + tile_size - 1) / tile_size;
+    const std::size_t tiles = std::size_t(columns) * rows;
+    const std::size_t n = graph.extent();
+    const std::size_t ranges = std::max<std::size_t>(1, std::min<std::size_t>(tasks.size() * 4, n / 4096));
+    auto range_begin = [n, ranges](std::size_t r) { return n * r / ranges; };
+
+    // Call f(tile) for every tile edge i has to be drawn in: the tiles the part
+    // of it on the screen crosses, walked from one to the next, so that a long
+    // edge only lands in the tiles along it and not in all of its bounding box.
+    auto for_each_tile = [&](std::uint32_t i, auto f) {
+        if (graph[i].next[1] == mesh<const P *>::no_edge)
+            return;
+        const P &a = *graph[i].data[0], &b = *graph[i].data[1];
+        double x0 = view.pixel_x(a.x), y0 = view.pixel_y(a.y), x1 = view.pixel_x(b.x), y1 = view.pixel_y(b.y);
+        double left = std::min(x0, x1), right = std::max(x0, x1), bottom = std::min(y0, y1), top = std::max(y0, y1);
+        if (right < 0 || left >= width || top < 0 || bottom >= height)
+            return;
+        if (right - left < 1 && top - bottom < 1) { // shaded into the pixel in the middle
+            double x = (x0 + x1) / 2, y = (y0 + y1) / 2;
+            if (x >= 0 && x < width && y >= 0 && y < height)
+                f(std::size_t(y / tile_size) * columns + std::size_t(x / tile_size));
+            return;
+        }
+        int first_column = int(std::max(left, 0.0) / tile_size), last_column = int(std::min(right, width - 1.0) / tile_size);
+        int first_row = int(std::max(bottom, 0.0) / tile_size), last_row = int(std::min(top, height - 1.0) / tile_size);
+        if (first_column == last_column || first_row == last_row) { // a line of tiles, which the edge crosses all of
+            for (int row = first_row; row <= last_row; row++)
+                for (int column = first_column; column <= last_column; column++)
+                    f(std::size_t(row) * columns + column);
+            return;
+        }
+
+        // the part of the edge on the screen runs from t_in to t_out of the
+        // way from (x0, y0) to (x1, y1)
+        const double dx = x1 - x0, dy = y1 - y0;
+        double t_in = 0, t_out = 1;
+        auto cut = [&](double from, double d, double size) {
+            if (d == 0) // inside along this axis, or the bounds above would have caught it
+                return;
+            double t0 = -from / d, t1 = (size - from) / d;
+            t_in = std::max(t_in, std::min(t0, t1));
+            t_out = std::min(t_out, std::max(t0, t1));
+        };
+        cut(x0, dx, width);
+        cut(y0, dy, height);
+        if (t_in > t_out)
+            return;
+
+        auto tile_of = [](double v, int count) { return std::clamp(int(std::floor(v / tile_size)), 0, count - 1); };
+        int column = tile_of(x0 + t_in * dx, columns), row = tile_of(y0 + t_in * dy, rows);
+        last_column = tile_of(x0 + t_out * dx, columns), last_row = tile_of(y0 + t_out * dy, rows);
+        const int column_step = dx > 0 ? 1 : -1, row_step = dy > 0 ? 1 : -1;
+        // how far along the edge it crosses into the next column and row, and
+        // how much further every column and row after that
+        auto crossing = [](double from, double d, int tile, int step) { return d == 0 ? INFINITY : ((tile + (step > 0)) * double(tile_size) - from) / d; };
+        double next_column = crossing(x0, dx, column, column_step), next_row = crossing(y0, dy, row, row_step);
+        const double column_width = dx == 0 ? INFINITY : tile_size / std::abs(dx), row_height = dy == 0 ? INFINITY : tile_size / std::abs(dy);
+        f(std::size_t(row) * columns + column);
+        while (column != last_column || row != last_row) {
+            if (row == last_row || (column != last_column && next_column < next_row)) {
+                column += column_step;
+                next_column += column_width;
+            } else {
+                row += row_step;
+                next_row += row_height;
+            }
+            f(std::size_t(row) * columns + column);
+        }
+    };
+
+    // count the edges every range puts in every tile, add the counts up into
+    // offsets, then have the ranges fill in their part of the bins
+    offsets.assign(tiles * ranges, 0);
+    tasks.parallel_for(0, ranges, 1, [&](std::size_t r) {
+        for (std::size_t i = range_begin(r); i < range_begin(r + 1); i++)
+            for_each_tile(std::uint32_t(i), [&](std::size_t t) { offsets[t * ranges + r]++; });
+    });
+    starts.resize(tiles + 1);
+    std::size_t total = 0;
+    for (std::size_t t = 0; t < tiles; t++) {
+        starts[t] = total;
+        for (std::size_t r = 0; r < ranges; r++) {
+            std::size_t count = offsets[t * ranges + r];
+            offsets[t * ranges + r] = total;
+            total += count;
+        }
+    }
+    starts[tiles] = total;
+    bins.resize(total);
+    tasks.parallel_for(0, ranges, 1, [&](std::size_t r) {
+        for (std::size_t i = range_begin(r); i < range_begin(r + 1); i++)
+            for_each_tile(std::uint32_t(i), [&](std::size_t t) { bins[offsets[t * ranges + r]++] = std::uint32_t(i); });
+    });
+
+    // draw the tiles, keeping the coverage of every pixel in 1/256 of a pixel
+    const std::uint32_t full = 256;
+    tasks.parallel_for(0, tiles, 1, [&](std::size_t t) {
+        const int x_begin = int(t % columns) * tile_size, y_begin = int(t / columns) * tile_size;
+        const int x_end = std::min(x_begin + tile_size, width), y_end = std::min(y_begin + tile_size, height);
+        std::uint32_t cover[tile_size][tile_size] = {};
+        auto mark = [&](int x, int y) { cover[y - y_begin][x - x_begin] = full; };
+
+        for (std::size_t k = starts[t]; k < starts[t + 1]; k++) {
+            const P &a = *graph[bins[k]].data[0], &b = *graph[bins[k]].data[1];
+            double x0 = view.pixel_x(a.x), y0 = view.pixel_y(a.y), x1 = view.pixel_x(b.x), y1 = view.pixel_y(b.y);
+            double dx = x1 - x0, dy = y1 - y0;
+            if (std::abs(dx) < 1 && std::abs(dy) < 1) {
+                std::uint32_t &c = cover[int((y0 + y1) / 2) - y_begin][int((x0 + x1) / 2) - x_begin];
+                c = std::min(full, c + std::uint32_t(std::sqrt(dx * dx + dy * dy) * full));
+                continue;
+            }
+            // step along the longer axis through the middle of every pixel
+            // the edge spans, and mark the pixel the edge is in there
+            bool steep = std::abs(dy) > std::abs(dx);
+            if (steep) {
+                std::swap(x0, y0);
+                std::swap(x1, y1);
+                std::swap(dx, dy);
+            }
+            if (x0 > x1) {
+                std::swap(x0, x1);
+                std::swap(y0, y1);
+            }
+            const int begin = steep ? y_begin : x_begin, end = steep ? y_end : x_end;
+            const int low = steep ? x_begin : y_begin, high = steep ? x_end : y_end;
+            const double slope = dy / dx;
+            int from = int(std::ceil(std::clamp(x0 - 0.5, double(begin), double(end)))), to = int(std::floor(std::clamp(x1 - 0.5, double(begin - 1), double(end - 1))));
+            for (int i = from; i <= to; i++) {
+                double j = std::floor(y0 + (i + 0.5 - x0) * slope);
+                if (j >= low && j < high)
+                    steep ? mark(int(j), i) : mark(i, int(j));
+            }
+        }
+
+        for (int y = y_begin; y < y_end; y++) {
+            std::uint32_t *row = pixels + std::size_t(y) * pitch;
+            for (int x = x_begin; x < x_end; x++) {
+                std::uint32_t c = cover[y - y_begin][x - x_begin], shaded = 0;
+                for (int shift = 0; shift < 32; shift += 8) {
+                    std::uint32_t from = background >> shift & 0xFF, to = line_color >> shift & 0xFF;
+                    shaded |= std::uint32_t(int(from) + (int(to) - int(from)) * int(c) / int(full)) << shift;
+                }
+                row[x] = shaded;
+            }
+        }
+    });
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "quad_edge.hh"
+#include "radix_sort.hh"
+#include "task_pool.hh"
+
+// Laying a finished triangulation out again so that what is close in the plane
+// is close in memory. The build leaves the points sorted by x, so neighbours
+// in y are far apart, and the quad_edges wherever the subproblem that made
+// them had its slab. relayout() sorts the points along a Hilbert curve, which
+// keeps nearby points nearby in every direction, then moves every quad_edge
+// next to the points it joins. Walks around the mesh, drawing it and queries
+// over it then touch far fewer cache lines. It costs about a sort of the
+// points and a few passes over the edges, so it pays off for meshes that are
+// kept and looked at many times.
+
+// The distance along the Hilbert curve through the 2^16 by 2^16 grid of the
+// cell (x, y), which only looks at the low 16 bits of x and y.
+inline std::uint32_t hilbert_index(std::uint32_t x, std::uint32_t y) {
+    std::uint32_t d = 0;
+    for (std::uint32_t s = 1 << 15; s > 0; s >>= 1) {
+        std::uint32_t rx = (x & s) != 0, ry = (y & s) != 0;
+        d += s * s * ((3 * rx) ^ ry);
+        if (ry == 0) { // turn the quadrant so the curve in it starts where the last one ended
+            if (rx == 1) {
+                x = ~x;
+                y = ~y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+// Reorder points along a Hilbert curve and the quad_edges of graph, whose
+// vertices must all be in points, to follow them, rewriting every link and
+// vertex of the mesh. outer is moved along to where its edge went. Returns,
+// for every old index into points, the new index of its point, so attributes
+// kept outside of the points can be carried along.
+template <typename P> std::vector<std::uint32_t> relayout(task_pool &tasks, mesh<const P *> &graph, std::vector<P> &points, edge_reference<const P *> &outer) {
+    // sort_unique() sorts by x, then y, so the key in x and a distinct index
+    // in y sorts by key without dropping anything
+    struct keyed {
+        std::uint32_t x, y;
+    };
+    const std::size_t n = points.size();
+    if (n == 0)
+        return {};
+
+    // the curve runs over the bounding box of the points, cut down to 16 bits
+    std::uint32_t min_x = ~0u, min_y = ~0u, max_x = 0, max_y = 0;
+    for (const P &p : points) {
+        min_x = std::min(min_x, radix_coordinate(p.x)), max_x = std::max(max_x, radix_coordinate(p.x));
+        min_y = std::min(min_y, radix_coordinate(p.y)), max_y = std::max(max_y, radix_coordinate(p.y));
+    }
+    unsigned shift = 0;
+    while (std::max(max_x - min_x, max_y - min_y) >> shift >= 1u << 16)
+        shift++;
+
+    std::vector<keyed> vertex_keys(n);
+    tasks.parallel_for(0, n, 4096, [&](std::size_t i) {
+        vertex_keys[i] = {hilbert_index((radix_coordinate(points[i].x) - min_x) >> shift, (radix_coordinate(points[i].y) - min_y) >> shift), std::uint32_t(i)};
+    });
+    std::vector<std::uint32_t> moved = sort_unique(tasks, vertex_keys);
+    std::vector<P> reordered(n);
+    tasks.parallel_for(0, n, 4096, [&](std::size_t k) { reordered[k] = points[vertex_keys[k].y]; });
+
+    // every quad_edge goes with the first of its ends along the curve, so the
+    // edges out of a point end up together. The ends are new indices of
+    // points, so a counting sort by them will do.
+    auto first_end = [&](edge_reference<const P *> e) { return std::min(moved[e.ORG - points.data()], moved[e.DEST - points.data()]); };
+    std::vector<std::uint32_t> starts(n + 1, 0); // the quad_edges of point k go to order[starts[k], starts[k + 1])
+    graph.for_each_edge([&](edge_reference<const P *> e) { starts[first_end(e) + 1]++; });
+    for (std::size_t k = 0; k < n; k++)
+        starts[k + 1] += starts[k];
+    std::vector<std::uint32_t> order(graph.size());
+    graph.for_each_edge([&](edge_reference<const P *> e) { order[starts[first_end(e)]++] = e.index(); });
+    std::vector<std::uint32_t> edge_moved = graph.reorder(order);
+    if (outer.m)
+        outer = graph.ref(edge_moved[outer.index()] << 2 | outer.r());
+
+    tasks.parallel_for(0, graph.extent(), 4096, [&](std::size_t i) {
+        for (const P *&v : graph[std::uint32_t(i)].data)
+            v = &reordered[moved[v - points.data()]];
+    });
+    points.swap(reordered);
+    return moved;
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "delaunay.hh"
+
+// Recording a triangulation as it is built so it can be watched afterwards, or
+// while it is still going, at any pace. The build reports every change it
+// makes to the mesh to a step_recorder, the steps go through a step_queue to
+// whoever displays them, and a step_replay turns them back into the edges of
+// the mesh after any number of steps, in either direction, without ever
+// holding up the build.
+
+// A recorded step. For a merge a and b are the indices of the first and last
+// point of the subproblem, otherwise those of the origin and destination of
+// the edge.
+struct step {
+    std::uint32_t a, b;
+    step_kind kind;
+};
+
+// An unbounded queue for one thread pushing and one popping, neither of which
+// ever waits for the other. Items go into blocks of block_size that are linked
+// on by the producer when they fill up and freed by the consumer once it has
+// taken everything in them.
+template <typename T, std::size_t block_size = 4096> class step_queue {
+  public:
+    step_queue() : head(new block), tail(head) {}
+    ~step_queue() {
+        while (head) {
+            block *next = head->next.load(std::memory_order_relaxed);
+            delete head;
+            head = next;
+        }
+    }
+
+    step_queue(const step_queue &) = delete;
+    step_queue &operator=(const step_queue &) = delete;
+
+    // Producer: add an item, or say that there won't be any more.
+    void push(const T &item) {
+        std::size_t n = tail->count.load(std::memory_order_relaxed);
+        if (n == block_size) {
+            block *b = new block;
+            tail->next.store(b, std::memory_order_release);
+            tail = b;
+            n = 0;
+        }
+        tail->items[n] = item;
+        tail->count.store(n + 1, std::memory_order_release);
+    }
+    void close() { closed.store(true, std::memory_order_release); }
+
+    // Consumer: append every item pushed so far to out. Returns false once the
+    // producer has closed the queue and everything in it has been taken.
+    bool pop_all(std::vector<T> &out) {
+        bool last = closed.load(std::memory_order_acquire); // anything pushed before the close is seen below
+        while (true) {
+            std::size_t n = head->count.load(std::memory_order_acquire);
+            out.insert(out.end(), head->items + taken, head->items + n);
+            taken = n;
+            block *next = n == block_size ? head->next.load(std::memory_order_acquire) : nullptr;
+            if (!next)
+                break;
+            delete head;
+            head = next;
+            taken = 0;
+        }
+        return !last;
+    }
+
+  private:
+    struct block {
+        T items[block_size];
+        std::atomic<std::size_t> count{0};
+        std::atomic<block *> next{nullptr};
+    };
+
+    block *head;           // consumer's
+    std::size_t taken = 0; // items of head the consumer has taken
+    block *tail;           // producer's
+    std::atomic<bool> closed{false};
+};
+
+// An observer for delaunay() that pushes every step onto a queue, with the
+// points numbered by where they are in the array starting at points.
+template <typename P> class step_recorder {
+  public:
+    step_recorder(step_queue<step> &queue, const P *points) : queue(queue), points(points) {}
+
+    void on_step(step_kind kind, edge_reference<const P *> e, const P &first, const P &last) {
+        if (kind == step_kind::merge)
+            queue.push({index(&first), index(&last), kind});
+        else
+            queue.push({index(e.ORG), index(e.DEST), kind});
+    }
+
+  private:
+    std::uint32_t index(const P *p) const { return std::uint32_t(p - points); }
+
+    step_queue<step> &queue;
+    const P *points;
+};
+
+// The edges of a recorded mesh after the first position() steps of its log.
+// Every step can be undone, so moving by k steps in either direction costs k
+// updates of a hash table, however long the log is.
+class step_replay {
+  public:
+    // Take the steps recorded since the last call. Returns false once the
+    // build is over and all of its steps have been taken.
+    bool fetch(step_queue<step> &queue) {
+        std::size_t old = log.size();
+        bool more = queue.pop_all(log);
+        for (std::size_t i = old; i < log.size(); i++)
+            if (log[i].kind == step_kind::merge)
+                merges.push_back(i);
+        return more;
+    }
+
+    std::size_t size() const { return log.size(); }
+    std::size_t position() const { return shown; }
+
+    void forward() {
+        if (shown < log.size())
+            apply(log[shown++], true);
+    }
+    void back() {
+        if (shown > 0)
+            apply(log[--shown], false);
+    }
+    void seek(std::size_t to) {
+        to = std::min(to, log.size());
+        while (shown < to)
+            forward();
+        while (shown > to)
+            back();
+    }
+
+    // Where the merges start in the log, in order.
+    const std::vector<std::size_t> &merge_steps() const { return merges; }
+
+    // The merge the current position is in, and the base edge it started
+    // with, or nullptr before the first merge or before the base is found.
+    const step *merging() const {
+        auto it = std::lower_bound(merges.begin(), merges.end(), shown);
+        return it == merges.begin() ? nullptr : &log[it[-1]];
+    }
+    const step *base() const {
+        const step *m = merging();
+        return m && m + 1 < log.data() + shown && m[1].kind == step_kind::base ? m + 1 : nullptr;
+    }
+
+    // The edges, as pairs of point indices.
+    const std::vector<std::pair<std::uint32_t, std::uint32_t>> &edges() const { return current; }
+
+  private:
+    static std::uint64_t key(std::uint32_t a, std::uint32_t b) { return std::uint64_t(std::min(a, b)) << 32 | std::max(a, b); }
+
+    void apply(const step &s, bool forward) {
+        if (s.kind == step_kind::merge)
+            return;
+        if ((s.kind == step_kind::delete_edge) != forward) {
+            where.emplace(key(s.a, s.b), current.size());
+            current.push_back({s.a, s.b});
+        } else {
+            auto it = where.find(key(s.a, s.b));
+            if (it == where.end())
+                return;
+            std::size_t i = it->second;
+            where.erase(it);
+            if (i + 1 != current.size()) {
+                current[i] = current.back();
+                where[key(current[i].first, current[i].second)] = i;
+            }
+            current.pop_back();
+        }
+    }
+
+    std::vector<step> log;
+    std::vector<std::size_t> merges;
+    std::size_t shown = 0;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> current;
+    std::unordered_map<std::uint64_t, std::size_t> where; // index of every edge in current
+};
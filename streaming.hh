@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "delaunay.hh"
+#include "flip.hh"
+#include "incremental.hh"
+#include "mapped_file.hh"
+#include "quad_edge.hh"
+#include "radix_sort.hh"
+#include "task_pool.hh"
+
+// Out-of-core triangulation of point sets that don't fit in memory.
+//
+// The input is a file of packed (x, y) pairs of 32 bit integers, which is
+// memory mapped and bucketed by x into vertical strips of about tile_points
+// points each. Strips are triangulated one at a time, left to right, and merged
+// onto the triangulation of everything before them with the same merge() as
+// the in-memory build. As soon as the circumcircle of a triangle lies entirely
+// left of the next strip no point still to come can invalidate it, so it is
+// written out. Edges between finished triangles are freed again unless a merge
+// could still look at them, which keeps memory bounded by a strip, the band of
+// unfinished triangles along its right side and the hull, rather than by the
+// number of points.
+//
+// The output is a file of triangles, each three 64 bit indices of points in the
+// input file in counter-clockwise order. Points that repeat the coordinates of
+// an earlier point are left out. The points are sorted into strips in a
+// scratch file next to the output, which needs as much room as the input twice.
+
+struct stream_point {
+    std::int32_t x, y;
+    std::uint64_t index; // where the point is in the input file
+    friend std::ostream &operator<<(std::ostream &lhs, const stream_point &rhs) { return lhs << '(' << rhs.x << ", " << rhs.y << ')'; }
+};
+
+// Prints what went wrong and returns false on failure.
+inline bool stream_triangulate(task_pool &tasks, const char *points_path, const char *triangles_path, std::size_t tile_points = 1 << 20) {
+    using edge = edge_reference<const stream_point *>;
+
+    mapped_file input;
+    if (!input.open(points_path)) {
+        std::cout << "Can't open " << points_path << "\n";
+        return false;
+    }
+    if (input.size() % (2 * sizeof(std::int32_t)) != 0) {
+        std::cout << points_path << " isn't a list of (x, y) pairs of 32 bit integers\n";
+        return false;
+    }
+    const std::int32_t *coordinates = reinterpret_cast<const std::int32_t *>(input.data());
+    const std::size_t n = input.size() / (2 * sizeof(std::int32_t));
+    if (n < 2) {
+        std::cout << points_path << " needs at least two points\n";
+        return false;
+    }
+    const std::size_t chunks = std::max<std::size_t>(1, std::min<std::size_t>(tasks.size() * 4, n / 65536));
+    auto chunk_begin = [n, chunks](std::size_t c) { return n * c / chunks; };
+
+    // bucket the points by x and cut the buckets into strips
+    std::vector<std::pair<std::int32_t, std::int32_t>> ranges(chunks, {std::numeric_limits<std::int32_t>::max(), std::numeric_limits<std::int32_t>::min()});
+    tasks.parallel_for(0, chunks, 1, [&](std::size_t c) {
+        for (std::size_t i = chunk_begin(c); i < chunk_begin(c + 1); i++) {
+            ranges[c].first = std::min(ranges[c].first, coordinates[2 * i]);
+            ranges[c].second = std::max(ranges[c].second, coordinates[2 * i]);
+        }
+    });
+    std::int64_t min_x = ranges[0].first, max_x = ranges[0].second;
+    for (auto [lo, hi] : ranges)
+        min_x = std::min<std::int64_t>(min_x, lo), max_x = std::max<std::int64_t>(max_x, hi);
+
+    const std::size_t buckets = 1 << 16;
+    const std::uint64_t width = std::uint64_t(max_x - min_x) + 1;
+    auto bucket = [=](std::int32_t x) { return std::size_t(std::uint64_t(x - min_x) * buckets / width); };
+    auto bucket_x = [=](std::size_t b) { return min_x + std::int64_t((std::uint64_t(b) * width + buckets - 1) / buckets); }; // lowest x in bucket b
+
+    std::vector<std::size_t> counts(chunks * buckets);
+    tasks.parallel_for(0, chunks, 1, [&](std::size_t c) {
+        for (std::size_t i = chunk_begin(c); i < chunk_begin(c + 1); i++)
+            counts[c * buckets + bucket(coordinates[2 * i])]++;
+    });
+    std::vector<std::size_t> strip_of(buckets), first_bucket{0};
+    std::size_t filled = 0;
+    for (std::size_t b = 0; b < buckets; b++) {
+        if (filled >= tile_points) {
+            first_bucket.push_back(b);
+            filled = 0;
+        }
+        strip_of[b] = first_bucket.size() - 1;
+        for (std::size_t c = 0; c < chunks; c++)
+            filled += counts[c * buckets + b];
+    }
+    const std::size_t strips = first_bucket.size();
+    first_bucket.push_back(buckets);
+
+    // scatter the points into their strips in the scratch file, every chunk
+    // writing where the chunks before it stop
+    std::string scratch_path = std::string(triangles_path) + ".strips";
+    mapped_file scratch;
+    if (!scratch.create(scratch_path.c_str(), n * sizeof(stream_point))) {
+        std::cout << "Can't create " << scratch_path << "\n";
+        return false;
+    }
+    stream_point *sorted = reinterpret_cast<stream_point *>(scratch.data());
+    std::vector<std::size_t> offsets(chunks * strips), strip_begin(strips + 1, 0);
+    for (std::size_t c = 0; c < chunks; c++)
+        for (std::size_t b = 0; b < buckets; b++)
+            offsets[c * strips + strip_of[b]] += counts[c * buckets + b];
+    for (std::size_t s = 0, sum = 0; s < strips; s++) {
+        strip_begin[s] = sum;
+        for (std::size_t c = 0; c < chunks; c++) {
+            std::size_t count = offsets[c * strips + s];
+            offsets[c * strips + s] = sum;
+            sum += count;
+        }
+    }
+    strip_begin[strips] = n;
+    counts = {};
+    tasks.parallel_for(0, chunks, 1, [&](std::size_t c) {
+        std::size_t *offset = &offsets[c * strips];
+        for (std::size_t i = chunk_begin(c); i < chunk_begin(c + 1); i++)
+            sorted[offset[strip_of[bucket(coordinates[2 * i])]]++] = {coordinates[2 * i], coordinates[2 * i + 1], i};
+    });
+    input.close();
+
+    std::ofstream output(triangles_path, std::ios::binary);
+    if (!output) {
+        std::cout << "Can't create " << triangles_path << "\n";
+        return false;
+    }
+
+    // What is known about the face to the left of a directed edge. Emitted
+    // faces have been written out, or are holes left where edges between
+    // written triangles were freed; exposed ones border on a face that isn't
+    // finished, so a merge might still look at them.
+    enum : std::uint8_t { emitted = 1, exposed = 2 };
+    std::vector<std::uint8_t> face;
+    std::vector<bool> outside;
+    std::vector<std::uint64_t> triangles;
+
+    mesh<const stream_point *> graph;
+    std::vector<stream_point> kept, strip; // points of the mesh so far, and of the strip being added
+    edge_pair<stream_point> hull;
+    bool empty = true;
+    std::size_t written = 0;
+
+    for (std::size_t s = 0; s < strips; s++) {
+        strip.insert(strip.end(), sorted + strip_begin[s], sorted + strip_begin[s + 1]);
+        sort_unique(tasks, strip);
+        if (s + 2 == strips) { // a last strip of a single point couldn't be merged on its own, so take it along now
+            std::vector<stream_point> last(sorted + strip_begin[s + 1], sorted + strip_begin[s + 2]);
+            sort_unique(tasks, last);
+            if (last.size() < 2) {
+                strip.insert(strip.end(), last.begin(), last.end());
+                s++;
+            }
+        }
+        if (strip.size() < 2 && s + 1 < strips) // too few to triangulate on their own, so they go with the next strip
+            continue;
+        if (strip.size() < 2 && empty) {
+            std::cout << points_path << " needs at least two different points\n";
+            return false;
+        }
+
+        if (strip.size() >= 2) {
+            edge_pair<stream_point> added = delaunay(graph, strip.begin(), strip.end(), false);
+            null_observer none;
+            hull = empty ? added : merge(graph, none, strip.begin(), strip.end(), hull.first, hull.second, added.first, added.second);
+            empty = false;
+        } else if (strip.size() == 1 && !insert_site(graph, hull.second, &strip[0])) {
+            // a single point at the very end, after nothing but points in a
+            // line, which means no triangle has been written or freed yet
+            strip.insert(strip.begin(), kept.begin(), kept.end());
+            graph.clear();
+            hull = delaunay(graph, strip.begin(), strip.end(), false);
+        }
+        face.resize(std::size_t(graph.extent()) * 4);
+        outside.assign(std::size_t(graph.extent()) * 4, false);
+        edge e = hull.second;
+        do {
+            outside[e.h] = true;
+            e = e.l_next();
+        } while (e != hull.second);
+
+        // write out the triangles that are finished
+        const double frontier = s + 1 < strips ? double(bucket_x(first_bucket[s + 1])) : std::numeric_limits<double>::infinity();
+        triangles.clear();
+        graph.for_each_edge([&](edge q) {
+            for (edge d : {q, q.sym()}) {
+                if (outside[d.h] || (face[d.h] & emitted) || !left_triangle(d))
+                    continue;
+                const stream_point &a = *d.ORG, &b = *d.DEST, &c = *d.l_prev().ORG;
+                double bx = double(b.x) - a.x, by = double(b.y) - a.y, cx = double(c.x) - a.x, cy = double(c.y) - a.y;
+                double det = 2 * (bx * cy - by * cx), b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+                double ux = (cy * b2 - by * c2) / det, uy = (bx * c2 - cx * b2) / det, r = std::sqrt(ux * ux + uy * uy);
+                if (!(a.x + ux + r + 1e-9 * (std::abs(ux) + r) + 1 < frontier))
+                    continue;
+                face[d.h] = face[d.l_next().h] = face[d.l_prev().h] = emitted;
+                triangles.insert(triangles.end(), {a.index, b.index, c.index});
+            }
+        });
+        output.write(reinterpret_cast<const char *>(triangles.data()), std::streamsize(triangles.size() * sizeof(std::uint64_t)));
+        written += triangles.size() / 3;
+
+        // free the edges between finished faces that no merge will look at
+        graph.for_each_edge([&](edge q) {
+            for (edge d : {q, q.sym()}) {
+                if (!(face[d.h] & emitted) || (face[d.h] & exposed) || (!outside[d.sym().h] && (face[d.sym().h] & emitted)))
+                    continue;
+                edge f = d;
+                do {
+                    face[f.h] |= exposed;
+                    f = f.l_next();
+                } while (f != d);
+            }
+        });
+        std::vector<edge> finished;
+        graph.for_each_edge([&](edge q) {
+            if (face[q.h] == emitted && face[q.sym().h] == emitted && !outside[q.h] && !outside[q.sym().h])
+                finished.push_back(q);
+        });
+        for (edge &q : finished) {
+            face[q.h] = face[q.sym().h] = 0;
+            delete_edge(graph, q);
+        }
+        for (std::size_t i = 0; i < face.size(); i++)
+            face[i] &= ~exposed;
+
+        // move the points that are still in use together, so the memory of
+        // the others can go
+        std::unordered_map<const stream_point *, const stream_point *> moved;
+        std::vector<stream_point> live;
+        graph.for_each_edge([&](edge q) {
+            for (const stream_point *p : {q.ORG, q.DEST})
+                if (moved.emplace(p, nullptr).second)
+                    live.push_back(*p);
+        });
+        live.shrink_to_fit();
+        moved.clear();
+        graph.for_each_edge([&](edge q) {
+            for (edge d : {q, q.sym()}) {
+                auto [it, added] = moved.emplace(d.ORG, nullptr);
+                if (added)
+                    it->second = &live[moved.size() - 1];
+                d.ORG = it->second;
+            }
+        });
+        kept.swap(live);
+        strip.clear();
+        strip.shrink_to_fit();
+    }
+
+    output.close();
+    scratch.close();
+    std::remove(scratch_path.c_str());
+    if (!output) {
+        std::cout << "Can't write " << triangles_path << "\n";
+        return false;
+    }
+    std::cout << "wrote " << written << " triangles\n";
+    return true;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fork-join pool with one task deque per worker. Workers push and pop at the
+// back of their own deque and steal from the front of the others' once they run
+// dry, so big subproblems near the root of a recursion are the ones that migrate.
+// A thread calling into the pool from outside works as worker 0 until its call
+// returns, which is why a pool of n workers only starts n - 1 threads.
+// Tasks must not throw.
+class task_pool {
+  public:
+    explicit task_pool(unsigned workers = std::thread::hardware_concurrency()) : queues(std::max(workers, 1u)) {
+        for (unsigned i = 1; i < queues.size(); i++)
+            threads.emplace_back([this, i] { work(i); });
+    }
+
+    ~task_pool() {
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &t : threads)
+            t.join();
+    }
+
+    task_pool(const task_pool &) = delete;
+    task_pool &operator=(const task_pool &) = delete;
+
+    unsigned size() const { return queues.size(); }
+
+    // Which worker the calling thread is, in [0, size()), for tasks that keep
+    // state of their own per worker. Threads outside the pool count as 0.
+    unsigned worker_index() const { return current_pool == this ? current_index : 0; }
+
+    // Run f and g, possibly in parallel, and return once both have finished.
+    // g is offered to other workers while the calling thread runs f; if nobody
+    // picked it up in the meantime the caller runs it too.
+    template <typename F, typename G> void fork_join(F f, G g) {
+        if (queues.size() == 1) {
+            f();
+            g();
+            return;
+        }
+        task t{[](void *arg) { (*static_cast<G *>(arg))(); }, &g};
+        unsigned index = worker_index();
+        push(index, &t);
+        f();
+        if (take_back(index, &t))
+            g();
+        else
+            wait(index, t);
+    }
+
+    // Call f(i) for every i in [begin, end), splitting the range in halves
+    // until the pieces are no longer than grain.
+    template <typename F> void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, const F &f) {
+        if (end - begin <= std::max<std::size_t>(grain, 1)) {
+            for (std::size_t i = begin; i < end; i++)
+                f(i);
+            return;
+        }
+        std::size_t mid = begin + (end - begin) / 2;
+        fork_join([&] { parallel_for(begin, mid, grain, f); }, [&] { parallel_for(mid, end, grain, f); });
+    }
+
+  private:
+    struct task {
+        void (*run)(void *);
+        void *arg;
+        std::atomic<bool> done{false};
+    };
+
+    struct queue {
+        std::mutex lock;
+        std::deque<task *> tasks;
+    };
+
+    inline static thread_local const task_pool *current_pool = nullptr;
+    inline static thread_local unsigned current_index = 0;
+
+    void push(unsigned index, task *t) {
+        {
+            std::lock_guard<std::mutex> guard(queues[index].lock);
+            queues[index].tasks.push_back(t);
+        }
+        pending.fetch_add(1);
+        { std::lock_guard<std::mutex> guard(sleep_lock); } // a worker can't miss the wake up between its check and its wait
+        wake.notify_one();
+    }
+
+    // Pop t off the back of our own deque if no one has stolen it yet.
+    bool take_back(unsigned index, task *t) {
+        std::lock_guard<std::mutex> guard(queues[index].lock);
+        if (queues[index].tasks.empty() || queues[index].tasks.back() != t)
+            return false;
+        queues[index].tasks.pop_back();
+        pending.fetch_sub(1);
+        return true;
+    }
+
+    task *find(unsigned index) {
+        {
+            std::lock_guard<std::mutex> guard(queues[index].lock);
+            if (!queues[index].tasks.empty()) {
+                task *t = queues[index].tasks.back();
+                queues[index].tasks.pop_back();
+                pending.fetch_sub(1);
+                return t;
+            }
+        }
+        for (std::size_t i = 1; i < queues.size(); i++) {
+            queue &victim = queues[(index + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task *t = victim.tasks.front();
+                victim.tasks.pop_front();
+                pending.fetch_sub(1);
+                return t;
+            }
+        }
+        return nullptr;
+    }
+
+    static void execute(task *t) {
+        t->run(t->arg);
+        t->done.store(true, std::memory_order_release);
+    }
+
+    // Keep busy with other work until somebody else finishes t.
+    void wait(unsigned index, task &t) {
+        while (!t.done.load(std::memory_order_acquire)) {
+            if (task *other = find(index))
+                execute(other);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    void work(unsigned index) {
+        current_pool = this;
+        current_index = index;
+        while (true) {
+            if (task *t = find(index)) {
+                execute(t);
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(sleep_lock);
+            wake.wait(guard, [this] { return stopping || pending.load() > 0; });
+            if (stopping)
+                return;
+        }
+    }
+
+    std::vector<queue> queues;
+    std::vector<std::thread> threads;
+    std::atomic<std::size_t> pending{0};
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+    bool stopping = false;
+};
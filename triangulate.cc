@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "delaunay.hh"
+#include "flip.hh"
+#include "instrument.hh"
+#include "mapped_file.hh"
+#include "quad_edge.hh"
+#include "radix_sort.hh"
+#include "task_pool.hh"
+
+// Triangulates a file of points without opening a window, for use in scripts
+// and on machines without a display. The points are read from a file, or from
+// standard input if there is none or it is -, either as text, two integers
+// x y per point separated by white space or commas with # starting a comment
+// up to the end of the line, or with --binary as packed (x, y) pairs of 32 bit
+// integers, the same as --stream takes. Coordinates must fit in 32 bits.
+//
+// The triangulation is written to standard output as text, one triangle per
+// line as the indices of its points in counter-clockwise order, or with
+// --edges one edge per line as the indices of its ends, or with --none not at
+// all. Indices count the points in the order they were read from 0, and a
+// point that repeats the coordinates of an earlier one is left out. Then come
+// two lines starting with # with how many points, edges and triangles there
+// were and how long reading, sorting, triangulating and writing took.
+//
+// usage: triangulate [--binary] [--edges | --triangles | --none] [--threads n] [points file]
+
+struct input_point {
+    std::int32_t x, y;
+    friend std::ostream &operator<<(std::ostream &lhs, const input_point &rhs) { return lhs << '(' << rhs.x << ", " << rhs.y << ')'; }
+};
+
+// Prints what went wrong and returns false if text isn't a list of pairs of
+// integers.
+bool parse_points(const char *text, std::size_t size, std::vector<input_point> &points) {
+    const char *p = text, *end = text + size;
+    std::int32_t pair[2];
+    int have = 0;
+    while (true) {
+        while (p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' || *p == ','))
+            p++;
+        if (p != end && *p == '#') {
+            p = std::find(p, end, '\n');
+            continue;
+        }
+        if (p == end)
+            break;
+        const char *number = p + (*p == '+'); // from_chars doesn't take a plus sign
+        auto [next, error] = std::from_chars(number, end, pair[have]);
+        if (error != std::errc()) {
+            std::cerr << "line " << std::count(text, p, '\n') + 1 << ": "
+                      << (error == std::errc::result_out_of_range ? "coordinate doesn't fit in 32 bits" : "expected an integer") << "\n";
+            return false;
+        }
+        p = next;
+        if (++have == 2) {
+            points.push_back({pair[0], pair[1]});
+            have = 0;
+        }
+    }
+    if (have != 0) {
+        std::cerr << "the last point has no y coordinate\n";
+        return false;
+    }
+    return true;
+}
+
+// Text written to standard output through a buffer of its own, since writing
+// millions of numbers through iostreams would take longer than the
+// triangulation.
+class output_buffer {
+  public:
+    ~output_buffer() { flush(); }
+
+    void number(std::uint64_t n) {
+        reserve(24);
+        used = std::to_chars(buffer + used, buffer + sizeof(buffer), n).ptr - buffer;
+    }
+    void put(char c) {
+        reserve(1);
+        buffer[used++] = c;
+    }
+    void flush() {
+        std::fwrite(buffer, 1, used, stdout);
+        used = 0;
+    }
+
+  private:
+    void reserve(std::size_t n) {
+        if (used + n > sizeof(buffer))
+            flush();
+    }
+
+    char buffer[1 << 16];
+    std::size_t used = 0;
+};
+
+template <typename F> double time_ms(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+enum class output_kind { triangles, edges, none };
+
+int main(int argc, char **argv) {
+    bool binary = false;
+    output_kind output = output_kind::triangles;
+    unsigned threads = std::thread::hardware_concurrency();
+    const char *path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--binary")
+            binary = true;
+        else if (arg == "--triangles")
+            output = output_kind::triangles;
+        else if (arg == "--edges")
+            output = output_kind::edges;
+        else if (arg == "--none")
+            output = output_kind::none;
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = unsigned(std::strtoul(argv[++i], nullptr, 10));
+        else if (!path && (arg == "-" || arg.compare(0, 2, "--") != 0))
+            path = argv[i];
+        else {
+            std::cerr << "usage: triangulate [--binary] [--edges | --triangles | --none] [--threads n] [points file]\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (path && path == std::string("-"))
+        path = nullptr;
+
+    // read the whole input, mapping a file and copying standard input
+    std::vector<input_point> points;
+    bool loaded = true;
+    double read_ms = time_ms([&] {
+        mapped_file file;
+        std::vector<char> piped;
+        const char *data;
+        std::size_t size;
+        if (path) {
+            if (!file.open(path)) {
+                std::cerr << "Can't open " << path << "\n";
+                loaded = false;
+                return;
+            }
+            data = file.data();
+            size = file.size();
+        } else {
+#ifdef _WIN32
+            if (binary)
+                _setmode(_fileno(stdin), _O_BINARY);
+#endif
+            char chunk[1 << 16];
+            for (std::size_t n; (n = std::fread(chunk, 1, sizeof(chunk), stdin)) > 0;)
+                piped.insert(piped.end(), chunk, chunk + n);
+            data = piped.data();
+            size = piped.size();
+        }
+        if (!binary) {
+            loaded = parse_points(data, size, points);
+        } else if (size % sizeof(input_point) != 0) {
+            std::cerr << (path ? path : "the input") << " isn't a list of (x, y) pairs of 32 bit integers\n";
+            loaded = false;
+        } else {
+            points.resize(size / sizeof(input_point));
+            if (size)
+                std::memcpy(points.data(), data, size);
+        }
+    });
+    if (!loaded)
+        return EXIT_FAILURE;
+    if (points.size() >= 0xFFFFFFFF) {
+        std::cerr << "can't triangulate more than " << 0xFFFFFFFE << " points\n";
+        return EXIT_FAILURE;
+    }
+
+    // sort, remembering where in the input every point that is left came from
+    task_pool tasks(threads);
+    const std::size_t read_points = points.size();
+    std::vector<std::uint32_t> original;
+    double sort_ms = time_ms([&] {
+        std::vector<std::uint32_t> sorted = sort_unique(tasks, points);
+        original.assign(points.size(), 0xFFFFFFFF);
+        for (std::size_t i = 0; i < sorted.size(); i++)
+            if (original[sorted[i]] == 0xFFFFFFFF)
+                original[sorted[i]] = std::uint32_t(i);
+    });
+
+    mesh<const input_point *> graph;
+    double build_ms = time_ms([&] {
+        if (points.size() >= 2)
+            parallel_delaunay(graph, tasks, points.begin(), points.end());
+    });
+
+    using edge = edge_reference<const input_point *>;
+    std::size_t triangles = 0;
+    double write_ms = time_ms([&] {
+        output_buffer out;
+        auto index = [&](const input_point *p) { return original[p - points.data()]; };
+        if (output == output_kind::edges)
+            graph.for_each_edge([&](edge q) {
+                out.number(index(q.ORG));
+                out.put(' ');
+                out.number(index(q.DEST));
+                out.put('\n');
+            });
+        for_each_triangle(graph, [&](edge d) {
+            triangles++;
+            if (output == output_kind::triangles) {
+                out.number(index(d.ORG));
+                out.put(' ');
+                out.number(index(d.DEST));
+                out.put(' ');
+                out.number(index(d.l_prev().ORG));
+                out.put('\n');
+            }
+        });
+    });
+
+    std::printf("# %zu points, %zu unique, %zu edges, %zu triangles, %u threads\n", read_points, points.size(), graph.size(), triangles, tasks.size());
+    std::printf("# read %.2f ms, sort %.2f ms, triangulate %.2f ms, write %.2f ms\n", read_ms, sort_ms, build_ms, write_ms);
+#ifdef INSTRUMENT
+    instrument_report(std::cout);
+#endif
+    return EXIT_SUCCESS;
+}
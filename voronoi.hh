@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "flip.hh"
+#include "quad_edge.hh"
+
+// The Voronoi diagram of the points of a Delaunay triangulation, read off its
+// dual. Every triangle is a Voronoi vertex at its circumcentre, and the dual
+// edge e.rot() runs between the vertices of the triangles to the right and to
+// the left of e. The cell of a point is the polygon of the circumcentres of
+// the triangles around it, except on the hull, where the cell is unbounded and
+// is instead cut out of the bounding box by the bisectors with its neighbours.
+// Cells are clipped to the bounding box either way.
+
+struct voronoi_point {
+    double x, y;
+};
+
+struct voronoi_box {
+    double left, bottom, right, top;
+};
+
+class voronoi_diagram {
+  public:
+    static constexpr std::uint32_t no_center = 0xFFFFFFFF;
+
+    // Work out the diagram of graph, clipped to box. Every vertex of the mesh
+    // must be one of the count points starting at points, and cell i is the
+    // cell of points[i].
+    template <typename P> void build(mesh<const P *> &graph, const P *points, std::size_t count, voronoi_box box);
+
+    // The circumcentre of every triangle.
+    const std::vector<voronoi_point> &centers() const { return circumcenters; }
+
+    // The index in centers() of the origin of a dual edge, which is the
+    // triangle to the right of the primal edge it is a rotation of, or
+    // no_center if that is the outside of the hull.
+    std::uint32_t center_at(edge_handle dual) const { return dual_origin[slot(dual)]; }
+
+    // The cell of points[i] as a counter-clockwise polygon, which is empty if
+    // the point isn't in the mesh or its cell misses the box.
+    std::size_t cells() const { return cell_start.size() - 1; }
+    const voronoi_point *cell_begin(std::size_t i) const { return cell_points.data() + cell_start[i]; }
+    const voronoi_point *cell_end(std::size_t i) const { return cell_points.data() + cell_start[i + 1]; }
+
+    double cell_area(std::size_t i) const {
+        double twice = 0;
+        for (const voronoi_point *p = cell_begin(i), *q = cell_end(i) - 1; p != cell_end(i); q = p++)
+            twice += q->x * p->y - p->x * q->y;
+        return twice / 2;
+    }
+
+  private:
+    // The dual edges of quad_edge i are i << 2 | 1 and i << 2 | 3.
+    static std::size_t slot(edge_handle dual) { return (dual >> 2) * 2 + (dual >> 1 & 1); }
+
+    // Cut away the part of polygon where nx * (x - px) + ny * (y - py) > 0.
+    void clip(std::vector<voronoi_point> &polygon, double nx, double ny, double px, double py) {
+        scratch.clear();
+        for (std::size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+            const voronoi_point &a = polygon[j], &b = polygon[i];
+            double fa = nx * (a.x - px) + ny * (a.y - py), fb = nx * (b.x - px) + ny * (b.y - py);
+            if ((fa > 0) != (fb > 0)) {
+                double t = fa / (fa - fb);
+                scratch.push_back({a.x + t * (b.x - a.x), a.y + t * (b.y - a.y)});
+            }
+            if (fb <= 0)
+                scratch.push_back(b);
+        }
+        polygon.swap(scratch);
+    }
+
+    void clip(std::vector<voronoi_point> &polygon, voronoi_box box) {
+        clip(polygon, -1, 0, box.left, 0);
+        clip(polygon, 0, -1, 0, box.bottom);
+        clip(polygon, 1, 0, box.right, 0);
+        clip(polygon, 0, 1, 0, box.top);
+    }
+
+    std::vector<std::uint32_t> dual_origin; // center_at() of every dual edge, by slot()
+    std::vector<voronoi_point> circumcenters;
+    std::vector<std::size_t> cell_start; // cell i is cell_points[cell_start[i], cell_start[i + 1])
+    std::vector<voronoi_point> cell_points;
+    std::vector<voronoi_point> scratch;
+};
+
+template <typename P> void voronoi_diagram::build(mesh<const P *> &graph, const P *points, std::size_t count, voronoi_box box) {
+    using edge = edge_reference<const P *>;
+
+    // number the triangles, storing the number of every one in the dual
+    // edges that start in it, and keep an edge out of every point
+    dual_origin.assign(std::size_t(graph.extent()) * 2, no_center);
+    std::vector<edge> corners; // an edge of every triangle
+    std::vector<edge> out(count, edge{nullptr, 0});
+    graph.for_each_edge([&](edge q) {
+        for (edge d : {q, q.sym()}) {
+            out[d.ORG - points] = d;
+            if (dual_origin[slot(d.rot(-1).h)] != no_center)
+                continue;
+            if (!left_triangle(d))
+                continue;
+            edge f = d.l_next();
+            std::uint32_t t = corners.size();
+            dual_origin[slot(d.rot(-1).h)] = dual_origin[slot(f.rot(-1).h)] = dual_origin[slot(f.l_next().rot(-1).h)] = t;
+            corners.push_back(d);
+        }
+    });
+
+    // the circumcentres, worked out all at once from the corners of the
+    // triangles gathered into one array per coordinate, so the compiler can
+    // vectorise the loop
+    const std::size_t triangles = corners.size();
+    std::vector<double> coordinates(triangles * 6);
+    double *ax = coordinates.data(), *ay = ax + triangles, *bx = ay + triangles, *by = bx + triangles, *cx = by + triangles, *cy = cx + triangles;
+    for (std::size_t t = 0; t < triangles; t++) {
+        const P &a = *corners[t].ORG, &b = *corners[t].DEST, &c = *corners[t].l_prev().ORG;
+        ax[t] = double(a.x), ay[t] = double(a.y);
+        bx[t] = double(b.x) - ax[t], by[t] = double(b.y) - ay[t]; // relative to a
+        cx[t] = double(c.x) - ax[t], cy[t] = double(c.y) - ay[t];
+    }
+    circumcenters.resize(triangles);
+    for (std::size_t t = 0; t < triangles; t++) {
+        double b2 = bx[t] * bx[t] + by[t] * by[t], c2 = cx[t] * cx[t] + cy[t] * cy[t];
+        double d = 2 * (bx[t] * cy[t] - by[t] * cx[t]);
+        circumcenters[t] = {ax[t] + (cy[t] * b2 - by[t] * c2) / d, ay[t] + (bx[t] * c2 - cx[t] * b2) / d};
+    }
+
+    // the cells
+    cell_start.assign(1, 0);
+    cell_points.clear();
+    std::vector<voronoi_point> cell;
+    for (std::size_t i = 0; i < count; i++) {
+        cell.clear();
+        if (out[i].m) {
+            // the triangles to the left of the edges around a point follow
+            // each other counter-clockwise
+            edge e = out[i];
+            bool bounded = true, inside = true;
+            do {
+                std::uint32_t t = dual_origin[slot(e.rot(-1).h)];
+                if (t == no_center) {
+                    bounded = false;
+                    break;
+                }
+                const voronoi_point &c = circumcenters[t];
+                if (cell.empty() || c.x != cell.back().x || c.y != cell.back().y)
+                    cell.push_back(c);
+                inside = inside && c.x >= box.left && c.x <= box.right && c.y >= box.bottom && c.y <= box.top;
+                e = e.o_next();
+            } while (e != out[i]);
+            if (cell.size() > 1 && cell.front().x == cell.back().x && cell.front().y == cell.back().y)
+                cell.pop_back();
+
+            if (!bounded) {
+                // on the hull: whatever of the box is closer to the point than
+                // to any of its neighbours
+                cell = {{box.left, box.bottom}, {box.right, box.bottom}, {box.right, box.top}, {box.left, box.top}};
+                const P &p = points[i];
+                e = out[i];
+                do {
+                    const P &q = *e.DEST;
+                    double dx = double(q.x) - double(p.x), dy = double(q.y) - double(p.y);
+                    clip(cell, dx, dy, double(p.x) + dx / 2, double(p.y) + dy / 2);
+                    e = e.o_next();
+                } while (e != out[i] && !cell.empty());
+            } else if (!inside) {
+                clip(cell, box);
+            }
+        }
+        cell_points.insert(cell_points.end(), cell.begin(), cell.end());
+        cell_start.push_back(cell_points.size());
+    }
+}